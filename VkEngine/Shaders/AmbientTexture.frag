@@ -1,7 +1,9 @@
 #version 460
+#extension GL_EXT_nonuniform_qualifier : require
 
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec2 texCoord;
+layout(location = 2) flat in uint materialIndex;
 
 layout(location = 0) out vec4 outColor;
 
@@ -13,9 +15,27 @@ layout(set = 0, binding = 1) uniform SceneData{
 	vec4 sunlightColor;
 } sceneData;
 
-layout(set = 2, binding = 0) uniform sampler2D tex1;
+struct MaterialData
+{
+	vec4 baseColor;
+	uint textureIndex; // 0xFFFFFFFF when the material has no texture
+};
+
+// parameters of every material, indexed through the object buffer
+layout(std140, set = 0, binding = 2) readonly buffer MaterialBuffer
+{
+	MaterialData materials[];
+} materialBuffer;
+
+// every texture in one array, sized when the set is allocated
+layout(set = 2, binding = 0) uniform sampler2D textures[];
 
 void main(){
-	vec3 color = texture(tex1, texCoord).xyz;
-	outColor = vec4(color, 1.0f);
+	MaterialData material = materialBuffer.materials[materialIndex];
+
+	vec4 color = material.baseColor;
+	if (material.textureIndex != 0xFFFFFFFFu)
+		color *= texture(textures[nonuniformEXT(material.textureIndex)], texCoord);
+
+	outColor = color;
 }
\ No newline at end of file
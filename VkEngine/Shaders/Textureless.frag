@@ -1,6 +1,7 @@
 #version 460
 
 layout(location = 0) in vec3 fragColor;
+layout(location = 1) flat in uint materialIndex;
 
 layout(location = 0) out vec4 outColor;
 
@@ -12,6 +13,19 @@ layout(set = 0, binding = 1) uniform SceneData{
 	vec4 sunlightColor;
 } sceneData;
 
+struct MaterialData
+{
+	vec4 baseColor;
+	uint textureIndex; // 0xFFFFFFFF when the material has no texture
+};
+
+// parameters of every material, indexed through the object buffer
+layout(std140, set = 0, binding = 2) readonly buffer MaterialBuffer
+{
+	MaterialData materials[];
+} materialBuffer;
+
 void main(){
-	outColor = vec4(fragColor, 1.0f);
+	vec4 baseColor = materialBuffer.materials[materialIndex].baseColor;
+	outColor = vec4(fragColor * baseColor.rgb, baseColor.a);
 }
\ No newline at end of file
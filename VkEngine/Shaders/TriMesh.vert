@@ -7,6 +7,7 @@ layout (location = 3) in vec2 vTexCoord;
 
 layout (location = 0) out vec3 fragColor;
 layout (location = 1) out vec2 texCoord;
+layout (location = 2) flat out uint materialIndex;
 
 layout (set = 0, binding = 0) uniform CameraBuffer
 {
@@ -15,22 +16,39 @@ layout (set = 0, binding = 0) uniform CameraBuffer
 	mat4 viewproj;
 } cameraData;
 
+// model matrix rows, the last row is always (0, 0, 0, 1) and isn't stored
 struct ObjectData
 {
-	mat4 model;
+	vec4 rows[3];
 };
 
 //all object matrices
-layout(std140, set = 1, binding = 0) readonly buffer ObjectBuffer
+layout(std430, set = 1, binding = 0) readonly buffer ObjectBuffer
 {
 	ObjectData objects[];
 } objectBuffer;
 
+// index into the material buffer per object
+layout(std430, set = 1, binding = 1) readonly buffer ObjectMaterialBuffer
+{
+	uint materialIndices[];
+} objectMaterials;
+
+// object of each drawn instance, rewritten every frame with the visible objects
+layout(std430, set = 1, binding = 2) readonly buffer InstanceBuffer
+{
+	uint objectIndices[];
+} instances;
+
 void main() 
 {
-	mat4 modelMatrix = objectBuffer.objects[gl_BaseInstance].model;
-	mat4 transformMatrix = (cameraData.viewproj * modelMatrix);
-	gl_Position = transformMatrix * vec4(vPosition, 1.0f);
+	// gl_InstanceIndex starts at firstInstance, the first object of the batch
+	uint objectIndex = instances.objectIndices[gl_InstanceIndex];
+	ObjectData object = objectBuffer.objects[objectIndex];
+	vec4 position = vec4(vPosition, 1.0f);
+	vec4 worldPosition = vec4(dot(object.rows[0], position), dot(object.rows[1], position), dot(object.rows[2], position), 1.0f);
+	gl_Position = cameraData.viewproj * worldPosition;
 	fragColor = vColor;
 	texCoord = vTexCoord;
+	materialIndex = objectMaterials.materialIndices[objectIndex];
 }
\ No newline at end of file
@@ -1,132 +1,848 @@
 #include <string>
 #include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <chrono>
+#include <mutex>
+#include <fstream>
+#include <unordered_map>
 #include "vk_engine/assets/assets.h"
+#include "VkEngine/Asset/Hash.h"
+#include "VkEngine/Asset/ObjParser.h"
+#include "VkEngine/Core/Parallel.h"
+#include "json.hpp"
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
-#define TINYOBJLOADER_IMPLEMENTATION
-#include "tiny_obj_loader.h"
 
-int main(int argc, char** argv) {
-	// texture
-	/*
-	for (int i = 1; i < argc; i++) {
-		std::string filePath = argv[i];
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+
+// bump whenever converter output changes so the manifest rebuilds everything
+constexpr uint32_t TOOL_VERSION = 3;
+
+enum class assetType {
+    MESH,
+    TEXTURE,
+    MATERIAL,
+    SCENE
+};
+
+enum class textureMode {
+    RGBA8, // raw texels with LZ4
+    BC,    // BC1, or BC3 when the image uses alpha
+    BC1,
+    BC3
+};
+
+struct convertOptions {
+    fs::path outputDir; // empty writes next to the source file
+    fs::path manifestPath;
+    unsigned int jobs = 0;
+    unsigned int parseWorkers = 1; // threads a single OBJ may use
+    bool force = false;
+    textureMode texture = textureMode::RGBA8;
+    bool flipTexcoordV = true;
+};
+
+struct convertJob {
+    fs::path source;
+    fs::path output;
+    assetType type;
+};
+
+struct convertResult {
+    bool success = false;
+    bool skipped = false; // output was up to date
+    uint64_t sourceHash = 0;
+    uint64_t optionsHash = 0;
+    std::unordered_map<std::string, uint64_t> dependencies; // other files read by the conversion and their hashes
+    uint64_t bytesIn = 0;
+    uint64_t bytesOut = 0;
+    double seconds = 0.0;
+};
+
+// what the last successful build produced for a source file
+struct manifestEntry {
+    uint64_t sourceHash = 0;
+    uint64_t optionsHash = 0;
+    uint32_t toolVersion = 0;
+    std::string output;
+    std::unordered_map<std::string, uint64_t> dependencies; // e.g. the .mtl libraries of an OBJ, 0 for ones that were missing
+};
+
+using buildManifest = std::unordered_map<std::string, manifestEntry>;
+
+static std::mutex logMutex;
+
+static std::string manifestKey(const fs::path& path) {
+    return fs::absolute(path).lexically_normal().generic_string();
+}
+
+static buildManifest loadManifest(const fs::path& path) {
+    buildManifest manifest;
+
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        return manifest;
+    }
+
+    try {
+        json manifestJson = json::parse(file);
+
+        for (const auto& [source, entryJson] : manifestJson["entries"].items()) {
+            manifestEntry entry;
+            if (!vk_engine::assets::hashFromString(entryJson["sourceHash"], entry.sourceHash) ||
+                !vk_engine::assets::hashFromString(entryJson["optionsHash"], entry.optionsHash)) {
+                continue;
+            }
+            entry.toolVersion = entryJson["toolVersion"];
+            entry.output = entryJson["output"];
+
+            bool dependenciesValid = true;
+            json dependenciesJson = entryJson.value("dependencies", json::object());
+            for (const auto& [dependency, hashJson] : dependenciesJson.items()) {
+                dependenciesValid &= vk_engine::assets::hashFromString(hashJson, entry.dependencies[dependency]);
+            }
+            if (!dependenciesValid) {
+                continue;
+            }
+
+            manifest[source] = entry;
+        }
+    }
+    catch (const std::exception& e) {
+        // a broken manifest only costs a full rebuild
+        std::cerr << "ignoring manifest " << path.string() << ": " << e.what() << std::endl;
+        manifest.clear();
+    }
+
+    return manifest;
+}
+
+static bool saveManifest(const fs::path& path, const buildManifest& manifest) {
+    json manifestJson;
+    manifestJson["entries"] = json::object();
+
+    for (const auto& [source, entry] : manifest) {
+        json entryJson;
+        entryJson["sourceHash"] = vk_engine::assets::hashToString(entry.sourceHash);
+        entryJson["optionsHash"] = vk_engine::assets::hashToString(entry.optionsHash);
+        entryJson["toolVersion"] = entry.toolVersion;
+        entryJson["output"] = entry.output;
+
+        entryJson["dependencies"] = json::object();
+        for (const auto& [dependency, hash] : entry.dependencies) {
+            entryJson["dependencies"][dependency] = vk_engine::assets::hashToString(hash);
+        }
+
+        manifestJson["entries"][source] = entryJson;
+    }
+
+    // write then rename so an interrupted run never leaves a truncated manifest
+    fs::path tempPath = path;
+    tempPath += ".tmp";
+
+    {
+        std::ofstream file(tempPath);
+        if (!file.is_open()) {
+            return false;
+        }
+        file << manifestJson.dump(1, '\t');
+    }
+
+    std::error_code ec;
+    fs::rename(tempPath, path, ec);
+
+    return !ec;
+}
+
+// a file that can't be read hashes as 0, so one recorded as missing stays unchanged until it appears
+static uint64_t hashDependency(const std::string& path) {
+    uint64_t hash = 0;
+    if (!vk_engine::assets::hashFile(path.c_str(), hash)) {
+        return 0;
+    }
+    return hash;
+}
+
+static bool dependenciesUnchanged(const std::unordered_map<std::string, uint64_t>& dependencies) {
+    for (const auto& [dependency, hash] : dependencies) {
+        if (hashDependency(dependency) != hash) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// only the options that influence the output of the given asset type
+static uint64_t hashOptions(assetType type, const convertOptions& options) {
+    std::string key;
+    switch (type) {
+    case assetType::MESH:
+        key = "mesh flipV=" + std::to_string(options.flipTexcoordV);
+        break;
+    case assetType::TEXTURE:
+        key = "texture mode=" + std::to_string((int) options.texture);
+        break;
+    case assetType::MATERIAL:
+        key = "material";
+        break;
+    case assetType::SCENE:
+        key = "scene";
+        break;
+    }
+    key += " tool=" + std::to_string(TOOL_VERSION);
+
+    return vk_engine::assets::hash64(key.data(), key.size());
+}
+
+static bool getAssetType(const fs::path& path, assetType& type) {
+    std::string ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char) std::tolower(c); });
+
+    if (ext == ".obj") {
+        type = assetType::MESH;
+        return true;
+    }
+
+    if (ext == ".png" || ext == ".jpg" || ext == ".jpeg" || ext == ".tga" || ext == ".bmp") {
+        type = assetType::TEXTURE;
+        return true;
+    }
+
+    if (ext == ".mat") {
+        type = assetType::MATERIAL;
+        return true;
+    }
+
+    if (ext == ".scene") {
+        type = assetType::SCENE;
+        return true;
+    }
+
+    return false;
+}
+
+// '*' and '?' match within one path component, '**' matches across components
+static bool wildcardMatch(const char* pattern, const char* text) {
+    if (*pattern == '\0') {
+        return *text == '\0';
+    }
+
+    if (pattern[0] == '*' && pattern[1] == '*') {
+        for (const char* t = text; ; t++) {
+            if (wildcardMatch(pattern + 2, t)) {
+                return true;
+            }
+            if (*t == '\0') {
+                return false;
+            }
+        }
+    }
+
+    if (*pattern == '*') {
+        for (const char* t = text; ; t++) {
+            if (wildcardMatch(pattern + 1, t)) {
+                return true;
+            }
+            if (*t == '\0' || *t == '/') {
+                return false;
+            }
+        }
+    }
+
+    if (*text == '\0') {
+        return false;
+    }
 
-		int texWidth, texHeight, texChannels;
+    if (*pattern == '?' ? *text != '/' : *pattern == *text) {
+        return wildcardMatch(pattern + 1, text + 1);
+    }
 
-		stbi_uc* pixels = stbi_load(filePath.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+    return false;
+}
 
-		if (!pixels) {
-			return false;
-		}
+static void addJob(std::vector<convertJob>& jobs, const fs::path& source, const fs::path& root, const convertOptions& options) {
+    convertJob job;
+    if (!getAssetType(source, job.type)) {
+        return;
+    }
 
-		vk_engine::assets::textureInfo info{};
-		info.width = texWidth;
-		info.height = texHeight;
-		info.textureSize = texWidth * texHeight * 4;
-		info.format = vk_engine::assets::textureFormat::RGBA8;
+    job.source = source;
 
-		void* pixel_ptr = pixels;
+    // keep the layout below the input root so files with equal names don't collide
+    if (options.outputDir.empty()) {
+        job.output = source;
+    }
+    else {
+        job.output = options.outputDir / source.lexically_relative(root);
+    }
+    // a material may share its name with its texture, a scene with its mesh
+    if (job.type == assetType::MATERIAL) {
+        job.output.replace_extension(".mat.asset");
+    }
+    else if (job.type == assetType::SCENE) {
+        job.output.replace_extension(".scene.asset");
+    }
+    else {
+        job.output.replace_extension(".asset");
+    }
 
-		vk_engine::assets::assetFile file = vk_engine::assets::packTexture(&info, pixel_ptr);
+    jobs.push_back(job);
+}
 
-		std::cout << filePath.substr(0, filePath.size() - 4) + ".asset" << std::endl;
+// inputs can be files, directories (scanned recursively) or glob patterns
+static void collectJobs(std::vector<convertJob>& jobs, const std::string& input, const convertOptions& options) {
+    std::string pattern = fs::path(input).generic_string();
+    size_t wildcard = pattern.find_first_of("*?");
 
-		vk_engine::assets::saveAssetFile((filePath.substr(0, filePath.size() - 4) + ".asset").c_str(), file);
-	}
+    if (wildcard == std::string::npos) {
+        fs::path path(input);
 
-	return 0;
+        if (fs::is_directory(path)) {
+            for (const auto& dirEntry : fs::recursive_directory_iterator(path)) {
+                if (dirEntry.is_regular_file()) {
+                    addJob(jobs, dirEntry.path(), path, options);
+                }
+            }
+        }
+        else if (fs::is_regular_file(path)) {
+            addJob(jobs, path, path.parent_path(), options);
+        }
+        else {
+            std::cerr << "input not found: " << input << std::endl;
+        }
 
-	*/
+        return;
+    }
 
-    // std::string filePath = argv[1];
-    std::string filePath = "D:/cdev/vk_engine/vk_engine/build/assets/Exterior/exterior.obj";
+    // scan from the last directory before the first wildcard
+    size_t slash = pattern.rfind('/', wildcard);
+    fs::path root = slash == std::string::npos ? fs::path(".") : fs::path(pattern.substr(0, slash + 1));
+    std::string relPattern = slash == std::string::npos ? pattern : pattern.substr(slash + 1);
 
-	// mesh
-    // attrib will contain the vertex arrays of the file
-    tinyobj::attrib_t attrib;
-    // shapes contain the vertices of each separate object in the file
-    std::vector<tinyobj::shape_t> shapes;
-    // materials contain the material of each separate object in the file
-    std::vector<tinyobj::material_t> materials;
+    if (!fs::is_directory(root)) {
+        std::cerr << "input not found: " << input << std::endl;
+        return;
+    }
 
-    // err stands for error
+    for (const auto& dirEntry : fs::recursive_directory_iterator(root)) {
+        if (dirEntry.is_regular_file()) {
+            std::string rel = dirEntry.path().lexically_relative(root).generic_string();
+            if (wildcardMatch(relPattern.c_str(), rel.c_str())) {
+                addJob(jobs, dirEntry.path(), root, options);
+            }
+        }
+    }
+}
+
+static bool saveAsset(const convertJob& job, vk_engine::assets::assetFile& file, uint64_t sourceHash) {
+    fs::path source = fs::absolute(job.source).lexically_relative(fs::absolute(job.output).parent_path());
+    vk_engine::assets::setAssetSource(file, source.generic_string(), sourceHash);
+
+    return vk_engine::assets::saveAssetFile(job.output.string().c_str(), file);
+}
+
+static bool convertTexture(const convertJob& job, const convertOptions& options, uint64_t sourceHash) {
+    int texWidth, texHeight, texChannels;
+
+    stbi_uc* pixels = stbi_load(job.source.string().c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+
+    if (!pixels) {
+        return false;
+    }
+
+    vk_engine::assets::textureInfo info{};
+    info.width = texWidth;
+    info.height = texHeight;
+    info.textureSize = (uint64_t) texWidth * texHeight * 4;
+    info.format = vk_engine::assets::textureFormat::RGBA8;
+    info.compression = vk_engine::assets::compressionMode::LZ4;
+
+    if (options.texture != textureMode::RGBA8) {
+        bool useBC3 = options.texture == textureMode::BC3;
+
+        // BC3 only when the alpha channel is actually used
+        if (options.texture == textureMode::BC) {
+            for (size_t i = 3; i < info.textureSize; i += 4) {
+                if (pixels[i] != 255) {
+                    useBC3 = true;
+                    break;
+                }
+            }
+        }
+
+        info.format = useBC3 ? vk_engine::assets::textureFormat::BC3 : vk_engine::assets::textureFormat::BC1;
+        info.compression = vk_engine::assets::compressionMode::BCLZ4;
+    }
+
+    void* pixel_ptr = pixels;
+
+    vk_engine::assets::assetFile file = vk_engine::assets::packTexture(&info, pixel_ptr);
+
+    stbi_image_free(pixels);
+
+    return saveAsset(job, file, sourceHash);
+}
+
+static bool convertMesh(const convertJob& job, const convertOptions& options, uint64_t sourceHash, std::unordered_map<std::string, uint64_t>& dependencies) {
+    vk_engine::assets::objParseOptions parseOptions;
+    parseOptions.workers = options.parseWorkers;
+    parseOptions.flipTexcoordV = options.flipTexcoordV;
+
+    // vertices go straight from the parser into the block compressor
+    vk_engine::assets::meshPacker packer;
+    vk_engine::assets::beginPackMesh(packer);
+
+    vk_engine::assets::objLayout layout;
+    vk_engine::assets::objStats stats;
     std::string err;
-    bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &err, filePath.c_str());
+    bool ret = vk_engine::assets::parseObj(job.source.string().c_str(), parseOptions,
+        [&](const vk_engine::assets::Vertex* vertices, size_t count) {
+            vk_engine::assets::packMeshData(packer, vertices, count * sizeof(vertices[0]));
+        }, layout, stats, err);
 
     if (!err.empty()) {
-        std::cerr << err << std::endl;
+        std::lock_guard<std::mutex> lock(logMutex);
+        std::cerr << job.source.string() << ": " << err << std::endl;
     }
 
     if (!ret) {
-        return 0;
+        return false;
     }
 
-    vk_engine::assets::Mesh meshes;
-    vk_engine::assets::meshInfo info{};
+    // a missing material library only costs the colours and maps, the ranges are still valid
+    std::vector<vk_engine::assets::objMaterial> libraryMaterials;
+    for (const std::string& library : layout.materialLibraries) {
+        std::string mtlErr;
+        fs::path libraryPath = job.source.parent_path() / library;
 
-    std::cout << "shapeSize: " << shapes.size() << std::endl;
+        // the materials are baked into the asset, so editing a library has to convert the mesh again
+        dependencies[manifestKey(libraryPath)] = hashDependency(libraryPath.string());
 
-    for (size_t s = 0; s < shapes.size(); s++) {
+        if (!vk_engine::assets::parseMtl(libraryPath.string().c_str(), libraryMaterials, mtlErr)) {
+            std::lock_guard<std::mutex> lock(logMutex);
+            std::cerr << job.source.string() << ": " << mtlErr << std::endl;
+        }
+    }
 
-        size_t index_offset = 0;
-        // loop over faces
-        for (size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); f++) {
-            int fv = shapes[s].mesh.num_face_vertices[f];
-            // loop over vertices of face
-            for (size_t v = 0; v < fv; v++) {
-                // access to vertex
-                tinyobj::index_t idx = shapes[s].mesh.indices[index_offset + v];
-                float vx = attrib.vertices[3 * idx.vertex_index + 0];
-                float vy = attrib.vertices[3 * idx.vertex_index + 1];
-                float vz = attrib.vertices[3 * idx.vertex_index + 2];
-                float nx = attrib.normals[3 * idx.normal_index + 0];
-                float ny = attrib.normals[3 * idx.normal_index + 1];
-                float nz = attrib.normals[3 * idx.normal_index + 2];
+    // one material entry per name in order of first use, groups without usemtl share the unnamed one
+    std::unordered_map<std::string, uint32_t> materialIndices;
+    std::vector<vk_engine::assets::submeshInfo>& submeshes = packer.info.submeshes;
+    std::vector<vk_engine::assets::meshMaterial>& materials = packer.info.materials;
+
+    for (const vk_engine::assets::objGroup& group : layout.groups) {
+        auto it = materialIndices.find(group.material);
+        if (it == materialIndices.end()) {
+            vk_engine::assets::meshMaterial material{ group.material, { 1.0f, 1.0f, 1.0f }, "" };
+            for (const vk_engine::assets::objMaterial& libraryMaterial : libraryMaterials) {
+                if (libraryMaterial.name == group.material) {
+                    std::copy(libraryMaterial.diffuse, libraryMaterial.diffuse + 3, material.diffuse);
+                    material.diffuseTexture = libraryMaterial.diffuseTexture;
+                }
+            }
+
+            it = materialIndices.emplace(group.material, (uint32_t) materials.size()).first;
+            materials.push_back(material);
+        }
+
+        vk_engine::assets::submeshInfo submesh;
+        submesh.firstVertex = group.firstVertex;
+        submesh.vertexCount = group.vertexCount;
+        submesh.material = it->second;
+        std::copy(group.boundsMin, group.boundsMin + 3, submesh.boundsMin);
+        std::copy(group.boundsMax, group.boundsMax + 3, submesh.boundsMax);
+        submeshes.push_back(submesh);
+    }
+
+    vk_engine::assets::assetFile file = vk_engine::assets::endPackMesh(packer, (uint32_t) stats.shapes);
+
+    return saveAsset(job, file, sourceHash);
+}
+
+/* material sources are json, e.g.
+* { "baseMaterial": "defaultMesh", "baseColor": [1, 1, 1, 1], "baseColorTexture": "textures/brick.png" }
+* the texture is converted on its own, the asset points at its output
+*/
+static bool convertMaterial(const convertJob& job, uint64_t sourceHash) {
+    std::ifstream source(job.source);
+    json materialJson = json::parse(source);
+
+    vk_engine::assets::materialInfo info{};
+    info.baseMaterial = materialJson.at("baseMaterial").get<std::string>();
+
+    std::vector<float> baseColor = materialJson.value("baseColor", std::vector<float>{ 1.0f, 1.0f, 1.0f, 1.0f });
+    if (baseColor.size() < 3 || baseColor.size() > 4) {
+        throw std::runtime_error("baseColor needs 3 or 4 components");
+    }
+    baseColor.resize(4, 1.0f);
+    std::copy(baseColor.begin(), baseColor.end(), info.baseColor);
+
+    // the relative layout of the sources is kept in the output directory
+    std::string texture = materialJson.value("baseColorTexture", std::string());
+    if (!texture.empty()) {
+        fs::path texturePath(texture);
+        assetType textureType;
+        if (!getAssetType(texturePath, textureType) || textureType != assetType::TEXTURE) {
+            throw std::runtime_error("unsupported texture " + texture);
+        }
+        info.baseColorTexture = texturePath.replace_extension(".asset").generic_string();
+    }
+
+    vk_engine::assets::assetFile file = vk_engine::assets::packMaterial(&info);
+
+    return saveAsset(job, file, sourceHash);
+}
+
+// source references point at what VkAsset converts them to, sources of another type are rejected
+static std::string sceneReference(const std::string& reference, assetType expected, const char* extension) {
+    fs::path path(reference);
+    assetType type;
+    if (!getAssetType(path, type) || type != expected) {
+        throw std::runtime_error("unsupported reference " + reference);
+    }
+
+    return path.replace_extension(extension).generic_string();
+}
 
-                vk_engine::assets::Vertex vertex;
-                vertex.position[0] = vx;
-                vertex.position[1] = vy;
-                vertex.position[2] = vz;
+static glm::mat4 sceneTransform(const json& nodeJson) {
+    if (nodeJson.contains("matrix")) {
+        std::vector<float> values = nodeJson["matrix"].get<std::vector<float>>();
+        if (values.size() != 16) {
+            throw std::runtime_error("matrix needs 16 components");
+        }
+
+        glm::mat4 matrix{ 1.0f };
+        std::copy(values.begin(), values.end(), &matrix[0][0]);
+        return matrix;
+    }
 
-                vertex.normal[0] = nx;
-                vertex.normal[1] = ny;
-                vertex.normal[2] = nz;
+    std::vector<float> position = nodeJson.value("position", std::vector<float>{ 0.0f, 0.0f, 0.0f });
+    std::vector<float> rotation = nodeJson.value("rotation", std::vector<float>{ 0.0f, 0.0f, 0.0f, 1.0f });
+    std::vector<float> scale{ 1.0f, 1.0f, 1.0f };
+    if (nodeJson.contains("scale")) {
+        const json& scaleJson = nodeJson["scale"];
+        scale = scaleJson.is_number() ? std::vector<float>(3, scaleJson.get<float>()) : scaleJson.get<std::vector<float>>();
+    }
 
-                vertex.color[0] = vertex.normal[0];
-                vertex.color[1] = vertex.normal[1];
-                vertex.color[2] = vertex.normal[2];
+    if (position.size() != 3 || rotation.size() != 4 || scale.size() != 3) {
+        throw std::runtime_error("position and scale need 3 components, rotation is a quaternion x y z w");
+    }
 
-                // vertex uv
-                tinyobj::real_t ux = attrib.texcoords[2 * idx.texcoord_index + 0];
-                tinyobj::real_t uy = attrib.texcoords[2 * idx.texcoord_index + 1];
+    glm::quat orientation(rotation[3], rotation[0], rotation[1], rotation[2]);
+
+    return glm::translate(glm::mat4{ 1.0f }, glm::vec3(position[0], position[1], position[2])) *
+        glm::mat4_cast(glm::normalize(orientation)) *
+        glm::scale(glm::mat4{ 1.0f }, glm::vec3(scale[0], scale[1], scale[2]));
+}
+
+struct sceneBuilder {
+    vk_engine::assets::sceneInfo info{};
+    std::vector<vk_engine::assets::sceneNode> nodes;
+    std::unordered_map<std::string, uint32_t> meshIndices;
+    std::unordered_map<std::string, uint32_t> materialIndices;
+};
+
+static uint32_t sceneIndex(const std::string& reference, std::unordered_map<std::string, uint32_t>& indices, std::vector<std::string>& list) {
+    auto it = indices.find(reference);
+    if (it == indices.end()) {
+        it = indices.emplace(reference, (uint32_t) list.size()).first;
+        list.push_back(reference);
+    }
 
-                vertex.uv[0] = ux;
-                vertex.uv[1] = 1 - uy;
+    return it->second;
+}
 
-                meshes._vertices.push_back(vertex);
+// depth first, so every parent is written before its children
+static void addSceneNode(sceneBuilder& builder, const json& nodeJson, uint32_t parent) {
+    vk_engine::assets::sceneNode node{};
+    node.parent = parent;
+    node.mesh = vk_engine::assets::SCENE_NONE;
+    node.material = vk_engine::assets::SCENE_NONE;
+
+    glm::mat4 transform = sceneTransform(nodeJson);
+    std::copy(&transform[0][0], &transform[0][0] + 16, node.transform);
+
+    if (nodeJson.contains("mesh")) {
+        std::string mesh = sceneReference(nodeJson["mesh"].get<std::string>(), assetType::MESH, ".asset");
+        node.mesh = sceneIndex(mesh, builder.meshIndices, builder.info.meshes);
+    }
+
+    if (nodeJson.contains("material")) {
+        std::string material = sceneReference(nodeJson["material"].get<std::string>(), assetType::MATERIAL, ".mat.asset");
+        node.material = sceneIndex(material, builder.materialIndices, builder.info.materials);
+    }
+
+    uint32_t index = (uint32_t) builder.nodes.size();
+    builder.nodes.push_back(node);
+
+    for (const json& child : nodeJson.value("children", json::array())) {
+        addSceneNode(builder, child, index);
+    }
+}
+
+/* scene sources are json, nodes nest through children, e.g.
+* { "defaultMaterial": "texturelessMesh", "nodes": [ { "scale": 0.05, "children": [ { "mesh": "Interior/interior.obj" } ] } ] }
+* a node is placed by "matrix" (16 floats, column major) or by "position", "rotation" (quaternion x y z w) and "scale"
+* meshes and materials are converted on their own, the asset lists their outputs once each
+*/
+static bool convertScene(const convertJob& job, uint64_t sourceHash) {
+    std::ifstream source(job.source);
+    json sceneJson = json::parse(source);
+
+    sceneBuilder builder;
+    builder.info.defaultMaterial = sceneJson.value("defaultMaterial", std::string("texturelessMesh"));
+
+    for (const json& node : sceneJson.at("nodes")) {
+        addSceneNode(builder, node, vk_engine::assets::SCENE_NONE);
+    }
+
+    builder.info.nodeCount = builder.nodes.size();
+
+    vk_engine::assets::assetFile file = vk_engine::assets::packScene(&builder.info, builder.nodes.data());
+
+    return saveAsset(job, file, sourceHash);
+}
+
+static convertResult convert(const convertJob& job, const convertOptions& options, const buildManifest& manifest) {
+    convertResult result;
+
+    auto start = std::chrono::steady_clock::now();
+
+    try {
+        result.bytesIn = fs::file_size(job.source);
+        result.optionsHash = hashOptions(job.type, options);
+
+        if (!vk_engine::assets::hashFile(job.source.string().c_str(), result.sourceHash)) {
+            throw std::runtime_error("failed to read source");
+        }
+
+        // unchanged source, options and tool version with the output still in place
+        auto it = manifest.find(manifestKey(job.source));
+        if (!options.force && it != manifest.end() &&
+            it->second.sourceHash == result.sourceHash &&
+            it->second.optionsHash == result.optionsHash &&
+            it->second.toolVersion == TOOL_VERSION &&
+            it->second.output == manifestKey(job.output) &&
+            fs::exists(job.output) &&
+            dependenciesUnchanged(it->second.dependencies)) {
+            result.success = true;
+            result.skipped = true;
+            result.dependencies = it->second.dependencies;
+            result.bytesOut = fs::file_size(job.output);
+            result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            return result;
+        }
+
+        // a bare file name converted in place has no parent to create
+        if (!job.output.parent_path().empty()) {
+            fs::create_directories(job.output.parent_path());
+        }
+
+        if (job.type == assetType::MESH) {
+            result.success = convertMesh(job, options, result.sourceHash, result.dependencies);
+        }
+        else if (job.type == assetType::MATERIAL) {
+            result.success = convertMaterial(job, result.sourceHash);
+        }
+        else if (job.type == assetType::SCENE) {
+            result.success = convertScene(job, result.sourceHash);
+        }
+        else {
+            result.success = convertTexture(job, options, result.sourceHash);
+        }
+
+        if (result.success) {
+            result.bytesOut = fs::file_size(job.output);
+        }
+    }
+    catch (const std::exception& e) {
+        std::lock_guard<std::mutex> lock(logMutex);
+        std::cerr << job.source.string() << ": " << e.what() << std::endl;
+        result.success = false;
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    result.seconds = std::chrono::duration<double>(end - start).count();
+
+    return result;
+}
+
+static void printUsage() {
+    std::cout << "usage: VkAsset [options] <file | directory | glob>...\n"
+        "  -o, --output <dir>         output directory, default writes next to the source\n"
+        "  -j, --jobs <n>             number of worker threads, default is one per core\n"
+        "  --texture-format <fmt>     rgba8 | bc | bc1 | bc3, bc picks bc3 only for images with alpha\n"
+        "  --bc                       same as --texture-format bc\n"
+        "  --no-flip-v                keep OBJ texture coordinates as authored\n"
+        "  --manifest <file>          build manifest, default is vkasset.manifest in the output directory\n"
+        "  -f, --force                convert everything even when the manifest says it is up to date\n";
+}
+
+static bool parseTextureMode(const std::string& value, textureMode& mode) {
+    if (value == "rgba8") mode = textureMode::RGBA8;
+    else if (value == "bc") mode = textureMode::BC;
+    else if (value == "bc1") mode = textureMode::BC1;
+    else if (value == "bc3") mode = textureMode::BC3;
+    else return false;
+
+    return true;
+}
+
+int main(int argc, char** argv) {
+    convertOptions options;
+    std::vector<std::string> inputs;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if ((arg == "-o" || arg == "--output") && hasValue) {
+            options.outputDir = argv[++i];
+        }
+        else if ((arg == "-j" || arg == "--jobs") && hasValue) {
+            options.jobs = (unsigned int) std::max(1, std::atoi(argv[++i]));
+        }
+        else if (arg == "--texture-format" && hasValue) {
+            if (!parseTextureMode(argv[++i], options.texture)) {
+                std::cerr << "unknown texture format: " << argv[i] << std::endl;
+                return 1;
             }
-            index_offset += fv;
         }
+        else if (arg == "--bc") {
+            options.texture = textureMode::BC;
+        }
+        else if (arg == "--no-flip-v") {
+            options.flipTexcoordV = false;
+        }
+        else if (arg == "--manifest" && hasValue) {
+            options.manifestPath = argv[++i];
+        }
+        else if (arg == "-f" || arg == "--force") {
+            options.force = true;
+        }
+        else if (arg == "-h" || arg == "--help") {
+            printUsage();
+            return 0;
+        }
+        else if (!arg.empty() && arg[0] == '-') {
+            std::cerr << "unknown option: " << arg << std::endl;
+            printUsage();
+            return 1;
+        }
+        else {
+            inputs.push_back(arg);
+        }
+    }
+
+    if (inputs.empty()) {
+        printUsage();
+        return 1;
     }
 
-    info.meshSize = meshes._vertices.size() * sizeof(meshes._vertices[0]);
-    info.shapeSize = shapes.size();
+    std::vector<convertJob> jobs;
+    for (const auto& input : inputs) {
+        collectJobs(jobs, input, options);
+    }
+
+    if (jobs.empty()) {
+        std::cerr << "no .obj, .png, .jpg, .jpeg, .tga, .bmp, .mat or .scene files found" << std::endl;
+        return 1;
+    }
+
+    if (options.manifestPath.empty()) {
+        options.manifestPath = (options.outputDir.empty() ? fs::path(".") : options.outputDir) / "vkasset.manifest";
+    }
+
+    buildManifest manifest = loadManifest(options.manifestPath);
 
-    std::cout << "packing meshes..." << std::endl;
+    unsigned int workers = options.jobs ? options.jobs : vk_engine::default_worker_count();
+    unsigned int fileWorkers = (unsigned int) std::min<size_t>(workers, jobs.size());
+    std::cout << "converting " << jobs.size() << " files on " << fileWorkers << " workers" << std::endl;
 
-    void* meshPtr = meshes._vertices.data();
-    vk_engine::assets::assetFile file = vk_engine::assets::packMesh(&info, meshPtr);
+    // spare workers go to parsing large meshes so a single big OBJ still uses every core
+    options.parseWorkers = std::max(1u, workers / fileWorkers);
 
-    std::cout << "packed mesh" << std::endl;
+    std::vector<convertResult> results(jobs.size());
 
-    std::cout << filePath.substr(0, filePath.size() - 4) + ".asset" << std::endl;
+    auto start = std::chrono::steady_clock::now();
+
+    vk_engine::parallel_for(jobs.size(), [&](size_t i) {
+        results[i] = convert(jobs[i], options, manifest);
+
+        const convertResult& result = results[i];
+
+        std::lock_guard<std::mutex> lock(logMutex);
+        if (result.skipped) {
+            std::printf("[skip] %s is up to date\n", jobs[i].source.string().c_str());
+        }
+        else if (result.success) {
+            std::printf("[ok]   %s -> %s  %.2f MB -> %.2f MB (%.2fx) in %.0f ms\n",
+                jobs[i].source.string().c_str(), jobs[i].output.string().c_str(),
+                result.bytesIn / 1e6, result.bytesOut / 1e6,
+                result.bytesOut ? (double) result.bytesIn / result.bytesOut : 0.0, result.seconds * 1e3);
+        }
+        else {
+            std::printf("[fail] %s\n", jobs[i].source.string().c_str());
+        }
+        std::fflush(stdout);
+    }, workers);
 
-    std::cout << "saving..." << std::endl;
+    auto end = std::chrono::steady_clock::now();
+    double wallSeconds = std::chrono::duration<double>(end - start).count();
+
+    // summary, skipped files don't count towards throughput
+    uint64_t bytesIn = 0;
+    uint64_t bytesOut = 0;
+    double cpuSeconds = 0.0;
+    size_t failed = 0;
+    size_t skipped = 0;
+
+    for (size_t i = 0; i < jobs.size(); i++) {
+        const convertResult& result = results[i];
+
+        if (result.skipped) {
+            skipped++;
+        }
+        else if (result.success) {
+            bytesIn += result.bytesIn;
+            bytesOut += result.bytesOut;
+        }
+        else {
+            failed++;
+        }
+        cpuSeconds += result.seconds;
+
+        // failed conversions drop out of the manifest so they are retried next run
+        std::string key = manifestKey(jobs[i].source);
+        if (result.success) {
+            manifestEntry& entry = manifest[key];
+            entry.sourceHash = result.sourceHash;
+            entry.optionsHash = result.optionsHash;
+            entry.toolVersion = TOOL_VERSION;
+            entry.output = manifestKey(jobs[i].output);
+            entry.dependencies = result.dependencies;
+        }
+        else {
+            manifest.erase(key);
+        }
+    }
+
+    if (!saveManifest(options.manifestPath, manifest)) {
+        std::cerr << "failed to write manifest " << options.manifestPath.string() << std::endl;
+    }
 
-    vk_engine::assets::saveAssetFile((filePath.substr(0, filePath.size() - 4) + ".asset").c_str(), file);
+    std::printf("\n%zu converted, %zu up to date, %zu failed in %.2f s (%.2f s summed over workers)\n", jobs.size() - failed - skipped, skipped, failed, wallSeconds, cpuSeconds);
+    std::printf("in:  %.2f MB, %.2f MB/s\n", bytesIn / 1e6, wallSeconds > 0.0 ? bytesIn / 1e6 / wallSeconds : 0.0);
+    std::printf("out: %.2f MB, %.2f MB/s\n", bytesOut / 1e6, wallSeconds > 0.0 ? bytesOut / 1e6 / wallSeconds : 0.0);
+    std::printf("compression ratio: %.2fx\n", bytesOut ? (double) bytesIn / bytesOut : 0.0);
 
-    return 0;
-}
\ No newline at end of file
+    return failed ? 1 : 0;
+}
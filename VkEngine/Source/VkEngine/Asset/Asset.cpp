@@ -1,8 +1,14 @@
 #include "vk_engine/assets/assets.h"
+#include "VkEngine/Asset/BlockCompression.h"
+#include "VkEngine/Asset/Hash.h"
+#include "VkEngine/Core/Parallel.h"
 #include "json.hpp"
 #include "lz4.h"
+#include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <filesystem>
 
 using json = nlohmann::json;
 
@@ -66,6 +72,51 @@ namespace vk_engine
             }
         }
 
+        void setAssetSource(assetFile& file, const std::string& sourcePath, uint64_t sourceHash)
+        {
+            json assetJson = json::parse(file.json);
+
+            assetJson["source"] = sourcePath;
+            assetJson["sourceHash"] = hashToString(sourceHash);
+
+            file.json = assetJson.dump();
+        }
+
+        bool readAssetSource(const assetFile& file, std::string& sourcePath, uint64_t& sourceHash)
+        {
+            json assetJson = json::parse(file.json);
+
+            if (!assetJson.contains("source") || !assetJson.contains("sourceHash"))
+            {
+                return false;
+            }
+
+            sourcePath = assetJson["source"];
+            return hashFromString(assetJson["sourceHash"], sourceHash);
+        }
+
+        bool isAssetStale(const char* assetPath, const assetFile& file)
+        {
+            std::string sourcePath;
+            uint64_t sourceHash;
+
+            if (!readAssetSource(file, sourcePath, sourceHash))
+            {
+                return false;
+            }
+
+            // assets shipped without their sources are never stale
+            std::filesystem::path source = std::filesystem::path(assetPath).parent_path() / sourcePath;
+
+            uint64_t currentHash;
+            if (!hashFile(source.string().c_str(), currentHash))
+            {
+                return false;
+            }
+
+            return currentHash != sourceHash;
+        }
+
         textureInfo readTextureInfo(assetFile* file)
         {
             textureInfo info;
@@ -76,13 +127,28 @@ namespace vk_engine
             info.height = textJson["height"];
             info.textureSize = textJson["textureSize"];
             info.format = textJson["format"];
+            info.compression = textJson.value("compression", compressionMode::LZ4);
 
             return info;
         }
 
         void unpackTexture(textureInfo* info, const char* sourcebuffer, size_t sourceSize, char* dest)
         {
-            LZ4_decompress_safe(sourcebuffer, dest, sourceSize, info->textureSize);
+            if (info->compression == compressionMode::BCLZ4)
+            {
+                std::vector<char> streams(info->textureSize);
+                LZ4_decompress_safe(sourcebuffer, streams.data(), sourceSize, info->textureSize);
+                mergeBlockStreams(info->format, streams.data(), info->textureSize, dest);
+            }
+            else
+            {
+                LZ4_decompress_safe(sourcebuffer, dest, sourceSize, info->textureSize);
+            }
+        }
+
+        void transcodeTexture(textureInfo* info, const char* texels, char* dest)
+        {
+            decodeBC(info->format, (const uint8_t*) texels, info->width, info->height, (uint8_t*) dest);
         }
 
         assetFile packTexture(textureInfo* info, void* pixelData)
@@ -94,22 +160,104 @@ namespace vk_engine
             file.type[3] = 'T';
             file.version = 0;
 
+            const char* texels = (const char*) pixelData;
+            std::vector<char> streams;
+
+            // pixelData is RGBA8, encode it into the requested block format first
+            if (info->compression == compressionMode::BCLZ4)
+            {
+                std::vector<char> blocks(blockCompressedSize(info->format, info->width, info->height));
+                encodeBC(info->format, (const uint8_t*) pixelData, info->width, info->height, (uint8_t*) blocks.data());
+
+                streams.resize(blocks.size());
+                splitBlockStreams(info->format, blocks.data(), blocks.size(), streams.data());
+
+                info->textureSize = streams.size();
+                texels = streams.data();
+            }
+            else
+            {
+                info->format = textureFormat::RGBA8;
+            }
+
             json textJson;
             textJson["width"] = info->width;
             textJson["height"] = info->height;
             textJson["textureSize"] = info->textureSize;
-            textJson["format"] = textureFormat::RGBA8;
+            textJson["format"] = info->format;
+            textJson["compression"] = info->compression;
             file.json = textJson.dump();
 
             // compress buffer into blob
             int compressStaging = LZ4_compressBound(info->textureSize);
             file.binaryBlob.resize(compressStaging);
-            int compressedSize = LZ4_compress_default((const char*) pixelData, file.binaryBlob.data(), info->textureSize, compressStaging);
+            int compressedSize = LZ4_compress_default(texels, file.binaryBlob.data(), info->textureSize, compressStaging);
             file.binaryBlob.resize(compressedSize);
 
             return file;
         }
 
+        static void writeMeshTables(json& meshJson, const meshInfo& info)
+        {
+            json submeshes = json::array();
+            for (const submeshInfo& submesh : info.submeshes)
+            {
+                json submeshJson;
+                submeshJson["firstVertex"] = submesh.firstVertex;
+                submeshJson["vertexCount"] = submesh.vertexCount;
+                submeshJson["material"] = submesh.material;
+                submeshJson["boundsMin"] = { submesh.boundsMin[0], submesh.boundsMin[1], submesh.boundsMin[2] };
+                submeshJson["boundsMax"] = { submesh.boundsMax[0], submesh.boundsMax[1], submesh.boundsMax[2] };
+                submeshes.push_back(submeshJson);
+            }
+
+            json materials = json::array();
+            for (const meshMaterial& material : info.materials)
+            {
+                json materialJson;
+                materialJson["name"] = material.name;
+                materialJson["diffuse"] = { material.diffuse[0], material.diffuse[1], material.diffuse[2] };
+                materialJson["diffuseTexture"] = material.diffuseTexture;
+                materials.push_back(materialJson);
+            }
+
+            meshJson["submeshes"] = submeshes;
+            meshJson["materials"] = materials;
+        }
+
+        static void readMeshTables(const json& meshJson, meshInfo& info)
+        {
+            if (meshJson.contains("submeshes"))
+            {
+                for (const json& submeshJson : meshJson["submeshes"])
+                {
+                    submeshInfo submesh;
+                    submesh.firstVertex = submeshJson["firstVertex"];
+                    submesh.vertexCount = submeshJson["vertexCount"];
+                    submesh.material = submeshJson["material"];
+                    for (int i = 0; i < 3; i++)
+                    {
+                        submesh.boundsMin[i] = submeshJson["boundsMin"][i];
+                        submesh.boundsMax[i] = submeshJson["boundsMax"][i];
+                    }
+                    info.submeshes.push_back(submesh);
+                }
+            }
+
+            if (meshJson.contains("materials"))
+            {
+                for (const json& materialJson : meshJson["materials"])
+                {
+                    meshMaterial material;
+                    material.name = materialJson["name"];
+                    for (int i = 0; i < 3; i++)
+                        material.diffuse[i] = materialJson["diffuse"][i];
+                    material.diffuseTexture = materialJson["diffuseTexture"];
+                    info.materials.push_back(material);
+                }
+            }
+        }
+
         meshInfo readMeshInfo(assetFile* file)
         {
             meshInfo info;
@@ -118,13 +266,36 @@ namespace vk_engine
 
             info.shapeSize = meshJson["shapeSize"];
             info.meshSize = meshJson["meshSize"];
+            info.blockSize = meshJson.value("blockSize", (uint64_t) 0);
+            info.blocks = meshJson.value("blocks", std::vector<uint64_t>());
+            readMeshTables(meshJson, info);
 
             return info;
         }
 
         void unpackMesh(meshInfo* info, const char* sourcebuffer, size_t sourceSize, char* dest)
         {
-            LZ4_decompress_safe(sourcebuffer, dest, sourceSize, info->meshSize);
+            // meshes packed before the block table are one LZ4 stream
+            if (info->blocks.empty())
+            {
+                LZ4_decompress_safe(sourcebuffer, dest, sourceSize, info->meshSize);
+                return;
+            }
+
+            std::vector<uint64_t> offsets(info->blocks.size());
+            uint64_t offset = 0;
+            for (size_t i = 0; i < info->blocks.size(); i++)
+            {
+                offsets[i] = offset;
+                offset += info->blocks[i];
+            }
+
+            parallel_for(info->blocks.size(), [&](size_t i)
+            {
+                uint64_t begin = i * info->blockSize;
+                uint64_t size = std::min(info->blockSize, info->meshSize - begin);
+                LZ4_decompress_safe(sourcebuffer + offsets[i], dest + begin, info->blocks[i], size);
+            });
         }
 
         assetFile packMesh(meshInfo* info, void* meshData)
@@ -139,6 +310,7 @@ namespace vk_engine
             json meshJson;
             meshJson["shapeSize"] = info->shapeSize;
             meshJson["meshSize"] = info->meshSize;
+            writeMeshTables(meshJson, *info);
             file.json = meshJson.dump();
 
             // compress buffer into blob
@@ -147,9 +319,163 @@ namespace vk_engine
             int compressedSize = LZ4_compress_default((const char*) meshData, file.binaryBlob.data(), info->meshSize, compressStaging);
             file.binaryBlob.resize(compressedSize);
 
-            std::cout << "meshSize: " << info->meshSize << std::endl;
-            std::cout << "compress staging: " << compressStaging << std::endl;
-            std::cout << "compressed size: " << compressedSize << std::endl;
+            return file;
+        }
+
+        static void flushMeshBlock(meshPacker& packer)
+        {
+            if (packer.staging.empty())
+                return;
+
+            size_t offset = packer.file.binaryBlob.size();
+            int compressStaging = LZ4_compressBound(packer.staging.size());
+            packer.file.binaryBlob.resize(offset + compressStaging);
+            int compressedSize = LZ4_compress_default(packer.staging.data(), packer.file.binaryBlob.data() + offset, packer.staging.size(), compressStaging);
+            packer.file.binaryBlob.resize(offset + compressedSize);
+
+            packer.info.blocks.push_back(compressedSize);
+            packer.staging.clear();
+        }
+
+        void beginPackMesh(meshPacker& packer, uint64_t blockSize)
+        {
+            packer.info = meshInfo{};
+            packer.info.blockSize = blockSize;
+            packer.staging.clear();
+            packer.staging.reserve(blockSize);
+            packer.file = assetFile{};
+        }
+
+        void packMeshData(meshPacker& packer, const void* data, size_t size)
+        {
+            const char* bytes = (const char*) data;
+            packer.info.meshSize += size;
+
+            while (size > 0)
+            {
+                size_t fill = std::min<size_t>(size, packer.info.blockSize - packer.staging.size());
+                packer.staging.insert(packer.staging.end(), bytes, bytes + fill);
+                bytes += fill;
+                size -= fill;
+
+                if (packer.staging.size() == packer.info.blockSize)
+                    flushMeshBlock(packer);
+            }
+        }
+
+        assetFile endPackMesh(meshPacker& packer, uint32_t shapeSize, meshInfo* info)
+        {
+            flushMeshBlock(packer);
+            packer.staging = std::vector<char>();
+            packer.info.shapeSize = shapeSize;
+
+            assetFile file = std::move(packer.file);
+            file.type[0] = 'M';
+            file.type[1] = 'E';
+            file.type[2] = 'S';
+            file.type[3] = 'H';
+            file.version = 0;
+
+            json meshJson;
+            meshJson["shapeSize"] = packer.info.shapeSize;
+            meshJson["meshSize"] = packer.info.meshSize;
+            meshJson["blockSize"] = packer.info.blockSize;
+            meshJson["blocks"] = packer.info.blocks;
+            writeMeshTables(meshJson, packer.info);
+            file.json = meshJson.dump();
+
+            if (info)
+                *info = packer.info;
+
+            return file;
+        }
+
+        materialInfo readMaterialInfo(assetFile* file)
+        {
+            materialInfo info;
+
+            json materialJson = json::parse(file->json);
+
+            info.baseMaterial = materialJson["baseMaterial"];
+            std::vector<float> baseColor = materialJson.value("baseColor", std::vector<float>{ 1.0f, 1.0f, 1.0f, 1.0f });
+            baseColor.resize(4, 1.0f);
+            std::copy(baseColor.begin(), baseColor.end(), info.baseColor);
+            info.baseColorTexture = materialJson.value("baseColorTexture", std::string());
+
+            return info;
+        }
+
+        assetFile packMaterial(materialInfo* info)
+        {
+            assetFile file;
+            file.type[0] = 'M';
+            file.type[1] = 'A';
+            file.type[2] = 'T';
+            file.type[3] = 'L';
+            file.version = 0;
+
+            json materialJson;
+            materialJson["baseMaterial"] = info->baseMaterial;
+            materialJson["baseColor"] = std::vector<float>(info->baseColor, info->baseColor + 4);
+            if (!info->baseColorTexture.empty())
+                materialJson["baseColorTexture"] = info->baseColorTexture;
+            file.json = materialJson.dump();
+
+            return file;
+        }
+
+        sceneInfo readSceneInfo(assetFile* file)
+        {
+            sceneInfo info;
+
+            json sceneJson = json::parse(file->json);
+
+            info.nodeCount = sceneJson["nodeCount"];
+            info.defaultMaterial = sceneJson.value("defaultMaterial", std::string());
+            info.meshes = sceneJson.value("meshes", std::vector<std::string>());
+            info.materials = sceneJson.value("materials", std::vector<std::string>());
+
+            return info;
+        }
+
+        bool unpackScene(sceneInfo* info, const char* sourcebuffer, size_t sourceSize, sceneNode* dest)
+        {
+            if (sourceSize != info->nodeCount * sizeof(sceneNode))
+                return false;
+
+            memcpy(dest, sourcebuffer, sourceSize);
+
+            for (uint64_t i = 0; i < info->nodeCount; i++)
+            {
+                const sceneNode& node = dest[i];
+
+                if ((node.parent != SCENE_NONE && node.parent >= i) ||
+                    (node.mesh != SCENE_NONE && node.mesh >= info->meshes.size()) ||
+                    (node.material != SCENE_NONE && node.material >= info->materials.size()))
+                    return false;
+            }
+
+            return true;
+        }
+
+        assetFile packScene(sceneInfo* info, const sceneNode* nodes)
+        {
+            assetFile file;
+            file.type[0] = 'S';
+            file.type[1] = 'C';
+            file.type[2] = 'N';
+            file.type[3] = 'E';
+            file.version = 0;
+
+            json sceneJson;
+            sceneJson["nodeCount"] = info->nodeCount;
+            sceneJson["defaultMaterial"] = info->defaultMaterial;
+            sceneJson["meshes"] = info->meshes;
+            sceneJson["materials"] = info->materials;
+            file.json = sceneJson.dump();
+
+            file.binaryBlob.resize(info->nodeCount * sizeof(sceneNode));
+            memcpy(file.binaryBlob.data(), nodes, file.binaryBlob.size());
 
             return file;
         }
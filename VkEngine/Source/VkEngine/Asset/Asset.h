@@ -10,7 +10,7 @@ namespace vk_engine
 
         struct assetFile
         {
-            char type[4]; // TEXT for texture, MESH for mesh
+            char type[4]; // TEXT for texture, MESH for mesh, MATL for material, SCNE for scene
             uint32_t version;
             std::string json;
             std::vector<char> binaryBlob;
@@ -19,17 +19,34 @@ namespace vk_engine
         bool saveAssetFile(const char* path, const assetFile& file);
         bool loadAssetFile(const char* path, assetFile& file);
 
+        // record the source file (relative to the asset) and its content hash in the asset json
+        void setAssetSource(assetFile& file, const std::string& sourcePath, uint64_t sourceHash);
+        bool readAssetSource(const assetFile& file, std::string& sourcePath, uint64_t& sourceHash);
+
+        // true when the recorded source still exists next to the asset and its content changed
+        bool isAssetStale(const char* assetPath, const assetFile& file);
+
         // texture
+        // values match the VkFormat the texture is uploaded as
         enum class textureFormat : uint32_t
         {
             UNDEFINED = 0,
-            RGBA8 = 43
+            RGBA8 = 43,
+            BC1 = 134,
+            BC3 = 138
+        };
+
+        enum class compressionMode : uint32_t
+        {
+            LZ4 = 0, // raw texels compressed with LZ4
+            BCLZ4 = 1 // BC blocks split into streams then compressed with LZ4
         };
 
         struct textureInfo
         {
-            uint64_t textureSize;
+            uint64_t textureSize; // size of the unpacked texels in format
             textureFormat format;
+            compressionMode compression;
             uint32_t width;
             uint32_t height;
         };
@@ -39,6 +56,9 @@ namespace vk_engine
         void unpackTexture(textureInfo* info, const char* sourcebuffer, size_t sourceSize, char* dest);
         assetFile packTexture(textureInfo* info, void* pixelData);
 
+        // decode unpacked BC texels into RGBA8 for devices without BC support, dest holds width * height * 4 bytes
+        void transcodeTexture(textureInfo* info, const char* texels, char* dest);
+
         // mesh
         struct Vertex
         {
@@ -53,15 +73,90 @@ namespace vk_engine
             std::vector<Vertex> _vertices;
         };
 
+        // a vertex range of the mesh drawn with one material
+        struct submeshInfo
+        {
+            uint64_t firstVertex;
+            uint64_t vertexCount;
+            uint32_t material; // index into meshInfo::materials
+            float boundsMin[3];
+            float boundsMax[3];
+        };
+
+        struct meshMaterial
+        {
+            std::string name;
+            float diffuse[3];
+            std::string diffuseTexture; // relative to the source mesh
+        };
+
         struct meshInfo
         {
             uint32_t shapeSize;
             uint64_t meshSize;
+            uint64_t blockSize; // uncompressed bytes per LZ4 block, 0 for a single block
+            std::vector<uint64_t> blocks; // compressed size of every block
+            std::vector<submeshInfo> submeshes; // empty for meshes packed without a submesh table
+            std::vector<meshMaterial> materials;
         };
 
         meshInfo readMeshInfo(assetFile* file);
         void unpackMesh(meshInfo* info, const char* sourcebuffer, size_t sourceSize, char* dest);
         assetFile packMesh(meshInfo* info, void* meshData);
+
+        constexpr uint64_t MESH_BLOCK_SIZE = 4 << 20;
+
+        /* streaming mesh packer, vertices are compressed into independent LZ4 blocks as they arrive
+        * so only one block of raw vertex data is ever held, the blocks also decompress in parallel
+        */
+        struct meshPacker
+        {
+            meshInfo info;
+            std::vector<char> staging;
+            assetFile file;
+        };
+
+        void beginPackMesh(meshPacker& packer, uint64_t blockSize = MESH_BLOCK_SIZE);
+        void packMeshData(meshPacker& packer, const void* data, size_t size);
+        assetFile endPackMesh(meshPacker& packer, uint32_t shapeSize, meshInfo* info = nullptr);
+
+        // material
+        // parameters for one of the renderer's base materials, which owns the pipeline
+        struct materialInfo
+        {
+            std::string baseMaterial;
+            float baseColor[4];
+            std::string baseColorTexture; // texture asset relative to the material asset, empty for none
+        };
+
+        materialInfo readMaterialInfo(assetFile* file);
+        assetFile packMaterial(materialInfo* info);
+
+        // scene
+        constexpr uint32_t SCENE_NONE = UINT32_MAX;
+
+        // one node of the flattened hierarchy, a parent always comes before its children
+        struct sceneNode
+        {
+            float transform[16]; // relative to the parent, column major
+            uint32_t parent; // index into the node array, SCENE_NONE for roots
+            uint32_t mesh; // index into sceneInfo::meshes, SCENE_NONE for a node without geometry
+            uint32_t material; // index into sceneInfo::materials for submeshes whose own material is unknown, SCENE_NONE uses the default
+            uint32_t padding;
+        };
+
+        struct sceneInfo
+        {
+            uint64_t nodeCount;
+            std::string defaultMaterial; // base material of the renderer
+            std::vector<std::string> meshes; // mesh assets relative to the scene asset
+            std::vector<std::string> materials; // material assets relative to the scene asset
+        };
+
+        sceneInfo readSceneInfo(assetFile* file);
+        // the nodes are stored as is so a scene is one read and one copy, false when the blob doesn't match the info
+        bool unpackScene(sceneInfo* info, const char* sourcebuffer, size_t sourceSize, sceneNode* dest);
+        assetFile packScene(sceneInfo* info, const sceneNode* nodes);
     }
 
 }
\ No newline at end of file
@@ -0,0 +1,374 @@
+#include "VkEngine/Asset/BlockCompression.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace vk_engine
+{
+
+    namespace assets
+    {
+
+        static size_t blockBytes(textureFormat format)
+        {
+            return format == textureFormat::BC3 ? 16 : 8;
+        }
+
+        static uint16_t packColor565(const float* color)
+        {
+            uint32_t r = (uint32_t) std::clamp(color[0], 0.0f, 255.0f);
+            uint32_t g = (uint32_t) std::clamp(color[1], 0.0f, 255.0f);
+            uint32_t b = (uint32_t) std::clamp(color[2], 0.0f, 255.0f);
+
+            return (uint16_t) ((((r * 31 + 127) / 255) << 11) | (((g * 63 + 127) / 255) << 5) | ((b * 31 + 127) / 255));
+        }
+
+        static void unpackColor565(uint16_t color, uint8_t* dest)
+        {
+            uint8_t r = (color >> 11) & 31;
+            uint8_t g = (color >> 5) & 63;
+            uint8_t b = color & 31;
+
+            dest[0] = (r << 3) | (r >> 2);
+            dest[1] = (g << 2) | (g >> 4);
+            dest[2] = (b << 3) | (b >> 2);
+            dest[3] = 255;
+        }
+
+        static void colorPalette(uint16_t c0, uint16_t c1, uint8_t palette[4][4])
+        {
+            unpackColor565(c0, palette[0]);
+            unpackColor565(c1, palette[1]);
+
+            for (int c = 0; c < 3; c++)
+            {
+                if (c0 > c1)
+                {
+                    palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                    palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+                }
+                else
+                {
+                    palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+                    palette[3][c] = 0;
+                }
+            }
+
+            palette[2][3] = 255;
+            palette[3][3] = c0 > c1 ? 255 : 0;
+        }
+
+        static void alphaPalette(uint8_t a0, uint8_t a1, uint8_t palette[8])
+        {
+            palette[0] = a0;
+            palette[1] = a1;
+
+            if (a0 > a1)
+            {
+                for (int i = 1; i < 7; i++)
+                    palette[i + 1] = (uint8_t) (((7 - i) * a0 + i * a1) / 7);
+            }
+            else
+            {
+                for (int i = 1; i < 5; i++)
+                    palette[i + 1] = (uint8_t) (((5 - i) * a0 + i * a1) / 5);
+                palette[6] = 0;
+                palette[7] = 255;
+            }
+        }
+
+        // fit the endpoints along the principal axis of the block colors
+        static void encodeColorBlock(const uint8_t block[16][4], uint8_t* dest)
+        {
+            float mean[3]{};
+            for (int i = 0; i < 16; i++)
+                for (int c = 0; c < 3; c++)
+                    mean[c] += block[i][c] / 16.0f;
+
+            // covariance matrix: rr, rg, rb, gg, gb, bb
+            float cov[6]{};
+            for (int i = 0; i < 16; i++)
+            {
+                float r = block[i][0] - mean[0];
+                float g = block[i][1] - mean[1];
+                float b = block[i][2] - mean[2];
+
+                cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+                cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+            }
+
+            // power iteration for the dominant eigenvector
+            float axis[3] = { 1.0f, 1.0f, 1.0f };
+            for (int iter = 0; iter < 8; iter++)
+            {
+                float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+                float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+                float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+
+                float len = std::max({ std::fabs(x), std::fabs(y), std::fabs(z) });
+                if (len < 1e-6f)
+                    break;
+
+                axis[0] = x / len;
+                axis[1] = y / len;
+                axis[2] = z / len;
+            }
+
+            int minIndex = 0;
+            int maxIndex = 0;
+            float minProj = INFINITY;
+            float maxProj = -INFINITY;
+
+            for (int i = 0; i < 16; i++)
+            {
+                float proj = block[i][0] * axis[0] + block[i][1] * axis[1] + block[i][2] * axis[2];
+                if (proj < minProj) { minProj = proj; minIndex = i; }
+                if (proj > maxProj) { maxProj = proj; maxIndex = i; }
+            }
+
+            float maxColor[3] = { (float) block[maxIndex][0], (float) block[maxIndex][1], (float) block[maxIndex][2] };
+            float minColor[3] = { (float) block[minIndex][0], (float) block[minIndex][1], (float) block[minIndex][2] };
+
+            uint16_t c0 = packColor565(maxColor);
+            uint16_t c1 = packColor565(minColor);
+
+            // keep c0 > c1 so the block stays in opaque four color mode
+            if (c0 < c1)
+                std::swap(c0, c1);
+
+            uint32_t selectors = 0;
+
+            if (c0 != c1)
+            {
+                uint8_t palette[4][4];
+                colorPalette(c0, c1, palette);
+
+                for (int i = 0; i < 16; i++)
+                {
+                    uint32_t best = 0;
+                    int bestError = INT32_MAX;
+
+                    for (uint32_t p = 0; p < 4; p++)
+                    {
+                        int dr = block[i][0] - palette[p][0];
+                        int dg = block[i][1] - palette[p][1];
+                        int db = block[i][2] - palette[p][2];
+                        int error = dr * dr + dg * dg + db * db;
+
+                        if (error < bestError)
+                        {
+                            bestError = error;
+                            best = p;
+                        }
+                    }
+
+                    selectors |= best << (2 * i);
+                }
+            }
+
+            memcpy(dest + 0, &c0, 2);
+            memcpy(dest + 2, &c1, 2);
+            memcpy(dest + 4, &selectors, 4);
+        }
+
+        static void encodeAlphaBlock(const uint8_t block[16][4], uint8_t* dest)
+        {
+            uint8_t a0 = 0;
+            uint8_t a1 = 255;
+
+            for (int i = 0; i < 16; i++)
+            {
+                a0 = std::max(a0, block[i][3]);
+                a1 = std::min(a1, block[i][3]);
+            }
+
+            uint64_t selectors = 0;
+
+            if (a0 != a1)
+            {
+                uint8_t palette[8];
+                alphaPalette(a0, a1, palette);
+
+                for (int i = 0; i < 16; i++)
+                {
+                    uint64_t best = 0;
+                    int bestError = INT32_MAX;
+
+                    for (uint64_t p = 0; p < 8; p++)
+                    {
+                        int error = std::abs(block[i][3] - palette[p]);
+                        if (error < bestError)
+                        {
+                            bestError = error;
+                            best = p;
+                        }
+                    }
+
+                    selectors |= best << (3 * i);
+                }
+            }
+
+            dest[0] = a0;
+            dest[1] = a1;
+            for (int i = 0; i < 6; i++)
+                dest[2 + i] = (uint8_t) (selectors >> (8 * i));
+        }
+
+        static void decodeColorBlock(const uint8_t* src, uint8_t block[16][4])
+        {
+            uint16_t c0, c1;
+            uint32_t selectors;
+            memcpy(&c0, src + 0, 2);
+            memcpy(&c1, src + 2, 2);
+            memcpy(&selectors, src + 4, 4);
+
+            uint8_t palette[4][4];
+            colorPalette(c0, c1, palette);
+
+            for (int i = 0; i < 16; i++)
+                memcpy(block[i], palette[(selectors >> (2 * i)) & 3], 4);
+        }
+
+        static void decodeAlphaBlock(const uint8_t* src, uint8_t block[16][4])
+        {
+            uint8_t palette[8];
+            alphaPalette(src[0], src[1], palette);
+
+            uint64_t selectors = 0;
+            for (int i = 0; i < 6; i++)
+                selectors |= (uint64_t) src[2 + i] << (8 * i);
+
+            for (int i = 0; i < 16; i++)
+                block[i][3] = palette[(selectors >> (3 * i)) & 7];
+        }
+
+        size_t blockCompressedSize(textureFormat format, uint32_t width, uint32_t height)
+        {
+            size_t blocksX = (width + 3) / 4;
+            size_t blocksY = (height + 3) / 4;
+            return blocksX * blocksY * blockBytes(format);
+        }
+
+        void encodeBC(textureFormat format, const uint8_t* pixels, uint32_t width, uint32_t height, uint8_t* dest)
+        {
+            uint32_t blocksX = (width + 3) / 4;
+            uint32_t blocksY = (height + 3) / 4;
+
+            for (uint32_t by = 0; by < blocksY; by++)
+            {
+                for (uint32_t bx = 0; bx < blocksX; bx++)
+                {
+                    // gather the block, clamping at the image border
+                    uint8_t block[16][4];
+                    for (uint32_t y = 0; y < 4; y++)
+                    {
+                        for (uint32_t x = 0; x < 4; x++)
+                        {
+                            uint32_t px = std::min(bx * 4 + x, width - 1);
+                            uint32_t py = std::min(by * 4 + y, height - 1);
+                            memcpy(block[y * 4 + x], pixels + ((size_t) py * width + px) * 4, 4);
+                        }
+                    }
+
+                    if (format == textureFormat::BC3)
+                    {
+                        encodeAlphaBlock(block, dest);
+                        encodeColorBlock(block, dest + 8);
+                        dest += 16;
+                    }
+                    else
+                    {
+                        encodeColorBlock(block, dest);
+                        dest += 8;
+                    }
+                }
+            }
+        }
+
+        void decodeBC(textureFormat format, const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* dest)
+        {
+            uint32_t blocksX = (width + 3) / 4;
+            uint32_t blocksY = (height + 3) / 4;
+
+            for (uint32_t by = 0; by < blocksY; by++)
+            {
+                for (uint32_t bx = 0; bx < blocksX; bx++)
+                {
+                    uint8_t block[16][4];
+
+                    if (format == textureFormat::BC3)
+                    {
+                        decodeColorBlock(blocks + 8, block);
+                        decodeAlphaBlock(blocks, block);
+                        blocks += 16;
+                    }
+                    else
+                    {
+                        decodeColorBlock(blocks, block);
+                        blocks += 8;
+                    }
+
+                    for (uint32_t y = 0; y < 4 && by * 4 + y < height; y++)
+                    {
+                        for (uint32_t x = 0; x < 4 && bx * 4 + x < width; x++)
+                        {
+                            memcpy(dest + ((size_t) (by * 4 + y) * width + bx * 4 + x) * 4, block[y * 4 + x], 4);
+                        }
+                    }
+                }
+            }
+        }
+
+        // field layout of a single block as { offset, size } pairs
+        static size_t blockFields(textureFormat format, size_t fields[4][2])
+        {
+            if (format == textureFormat::BC3)
+            {
+                // alpha endpoints, alpha selectors, color endpoints, color selectors
+                fields[0][0] = 0;  fields[0][1] = 2;
+                fields[1][0] = 2;  fields[1][1] = 6;
+                fields[2][0] = 8;  fields[2][1] = 4;
+                fields[3][0] = 12; fields[3][1] = 4;
+                return 4;
+            }
+
+            // color endpoints, color selectors
+            fields[0][0] = 0; fields[0][1] = 4;
+            fields[1][0] = 4; fields[1][1] = 4;
+            return 2;
+        }
+
+        void splitBlockStreams(textureFormat format, const char* blocks, size_t size, char* dest)
+        {
+            size_t fields[4][2];
+            size_t fieldCount = blockFields(format, fields);
+            size_t blockCount = size / blockBytes(format);
+
+            for (size_t f = 0; f < fieldCount; f++)
+            {
+                for (size_t b = 0; b < blockCount; b++)
+                {
+                    memcpy(dest, blocks + b * blockBytes(format) + fields[f][0], fields[f][1]);
+                    dest += fields[f][1];
+                }
+            }
+        }
+
+        void mergeBlockStreams(textureFormat format, const char* streams, size_t size, char* dest)
+        {
+            size_t fields[4][2];
+            size_t fieldCount = blockFields(format, fields);
+            size_t blockCount = size / blockBytes(format);
+
+            for (size_t f = 0; f < fieldCount; f++)
+            {
+                for (size_t b = 0; b < blockCount; b++)
+                {
+                    memcpy(dest + b * blockBytes(format) + fields[f][0], streams, fields[f][1]);
+                    streams += fields[f][1];
+                }
+            }
+        }
+    }
+
+}
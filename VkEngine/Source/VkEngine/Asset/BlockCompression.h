@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+#include "VkEngine/Asset/Asset.h"
+
+namespace vk_engine
+{
+
+    namespace assets
+    {
+
+        // size in bytes of a block compressed image, partial blocks are padded to 4x4
+        size_t blockCompressedSize(textureFormat format, uint32_t width, uint32_t height);
+
+        // encode RGBA8 pixels into BC1 (8 bytes per block) or BC3 (16 bytes per block)
+        void encodeBC(textureFormat format, const uint8_t* pixels, uint32_t width, uint32_t height, uint8_t* dest);
+
+        // decode BC1 / BC3 blocks back into RGBA8 pixels
+        void decodeBC(textureFormat format, const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* dest);
+
+        /* BC blocks interleave endpoints and selectors which LZ4 matches poorly,
+        * splitBlockStreams regroups every block field into its own stream before compression
+        * and mergeBlockStreams restores the layout the GPU expects
+        */
+        void splitBlockStreams(textureFormat format, const char* blocks, size_t size, char* dest);
+        void mergeBlockStreams(textureFormat format, const char* streams, size_t size, char* dest);
+    }
+
+}
@@ -0,0 +1,202 @@
+#include "VkEngine/Asset/Hash.h"
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <vector>
+
+namespace vk_engine
+{
+
+    namespace assets
+    {
+
+        static constexpr uint64_t PRIME1 = 0x9E3779B185EBCA87ULL;
+        static constexpr uint64_t PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+        static constexpr uint64_t PRIME3 = 0x165667B19E3779F9ULL;
+        static constexpr uint64_t PRIME4 = 0x85EBCA77C2B2AE63ULL;
+        static constexpr uint64_t PRIME5 = 0x27D4EB2F165667C5ULL;
+
+        static uint64_t rotl(uint64_t x, int r)
+        {
+            return (x << r) | (x >> (64 - r));
+        }
+
+        static uint64_t read64(const uint8_t* p)
+        {
+            uint64_t v;
+            memcpy(&v, p, sizeof(v));
+            return v;
+        }
+
+        static uint32_t read32(const uint8_t* p)
+        {
+            uint32_t v;
+            memcpy(&v, p, sizeof(v));
+            return v;
+        }
+
+        static uint64_t hashRound(uint64_t acc, uint64_t input)
+        {
+            acc += input * PRIME2;
+            acc = rotl(acc, 31);
+            return acc * PRIME1;
+        }
+
+        static uint64_t mergeRound(uint64_t acc, uint64_t val)
+        {
+            acc ^= hashRound(0, val);
+            return acc * PRIME1 + PRIME4;
+        }
+
+        void hashReset(hashState& state, uint64_t seed)
+        {
+            state.acc[0] = seed + PRIME1 + PRIME2;
+            state.acc[1] = seed + PRIME2;
+            state.acc[2] = seed;
+            state.acc[3] = seed - PRIME1;
+            state.seed = seed;
+            state.totalLength = 0;
+            state.bufferSize = 0;
+        }
+
+        void hashUpdate(hashState& state, const void* data, size_t size)
+        {
+            const uint8_t* p = (const uint8_t*) data;
+            const uint8_t* end = p + size;
+
+            state.totalLength += size;
+
+            // top up a partial stripe first
+            if (state.bufferSize + size < 32)
+            {
+                memcpy(state.buffer + state.bufferSize, p, size);
+                state.bufferSize += size;
+                return;
+            }
+
+            if (state.bufferSize > 0)
+            {
+                size_t fill = 32 - state.bufferSize;
+                memcpy(state.buffer + state.bufferSize, p, fill);
+                p += fill;
+
+                for (int i = 0; i < 4; i++)
+                    state.acc[i] = hashRound(state.acc[i], read64(state.buffer + i * 8));
+
+                state.bufferSize = 0;
+            }
+
+            for (; p + 32 <= end; p += 32)
+            {
+                for (int i = 0; i < 4; i++)
+                    state.acc[i] = hashRound(state.acc[i], read64(p + i * 8));
+            }
+
+            state.bufferSize = end - p;
+            memcpy(state.buffer, p, state.bufferSize);
+        }
+
+        uint64_t hashDigest(const hashState& state)
+        {
+            uint64_t h;
+
+            if (state.totalLength >= 32)
+            {
+                h = rotl(state.acc[0], 1) + rotl(state.acc[1], 7) + rotl(state.acc[2], 12) + rotl(state.acc[3], 18);
+                for (int i = 0; i < 4; i++)
+                    h = mergeRound(h, state.acc[i]);
+            }
+            else
+            {
+                h = state.seed + PRIME5;
+            }
+
+            h += state.totalLength;
+
+            const uint8_t* p = state.buffer;
+            const uint8_t* end = p + state.bufferSize;
+
+            for (; p + 8 <= end; p += 8)
+            {
+                h ^= hashRound(0, read64(p));
+                h = rotl(h, 27) * PRIME1 + PRIME4;
+            }
+
+            if (p + 4 <= end)
+            {
+                h ^= (uint64_t) read32(p) * PRIME1;
+                h = rotl(h, 23) * PRIME2 + PRIME3;
+                p += 4;
+            }
+
+            for (; p < end; p++)
+            {
+                h ^= (*p) * PRIME5;
+                h = rotl(h, 11) * PRIME1;
+            }
+
+            // avalanche
+            h ^= h >> 33;
+            h *= PRIME2;
+            h ^= h >> 29;
+            h *= PRIME3;
+            h ^= h >> 32;
+
+            return h;
+        }
+
+        uint64_t hash64(const void* data, size_t size, uint64_t seed)
+        {
+            hashState state;
+            hashReset(state, seed);
+            hashUpdate(state, data, size);
+            return hashDigest(state);
+        }
+
+        bool hashFile(const char* path, uint64_t& hash)
+        {
+            std::ifstream file(path, std::ios::binary | std::ios::in);
+
+            if (!file.is_open())
+            {
+                return false;
+            }
+
+            hashState state;
+            hashReset(state);
+
+            std::vector<char> chunk(1 << 20);
+            while (file)
+            {
+                file.read(chunk.data(), chunk.size());
+                hashUpdate(state, chunk.data(), (size_t) file.gcount());
+            }
+
+            hash = hashDigest(state);
+
+            return true;
+        }
+
+        std::string hashToString(uint64_t hash)
+        {
+            char text[17];
+            snprintf(text, sizeof(text), "%016llx", (unsigned long long) hash);
+            return text;
+        }
+
+        bool hashFromString(const std::string& text, uint64_t& hash)
+        {
+            if (text.size() != 16)
+            {
+                return false;
+            }
+
+            char* end = nullptr;
+            hash = strtoull(text.c_str(), &end, 16);
+
+            return end == text.c_str() + text.size();
+        }
+    }
+
+}
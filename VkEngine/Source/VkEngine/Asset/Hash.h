@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+namespace vk_engine
+{
+
+    namespace assets
+    {
+
+        // streaming 64 bit hash, output matches XXH64
+        struct hashState
+        {
+            uint64_t acc[4];
+            uint64_t seed;
+            uint64_t totalLength;
+            uint8_t buffer[32];
+            size_t bufferSize;
+        };
+
+        void hashReset(hashState& state, uint64_t seed = 0);
+        void hashUpdate(hashState& state, const void* data, size_t size);
+        uint64_t hashDigest(const hashState& state);
+
+        uint64_t hash64(const void* data, size_t size, uint64_t seed = 0);
+
+        // hash a whole file in fixed size chunks, returns false when it can't be read
+        bool hashFile(const char* path, uint64_t& hash);
+
+        std::string hashToString(uint64_t hash);
+        bool hashFromString(const std::string& text, uint64_t& hash);
+    }
+
+}
@@ -0,0 +1,560 @@
+#include "VkEngine/Asset/ObjParser.h"
+#include "VkEngine/Core/Parallel.h"
+#include <charconv>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
+namespace vk_engine
+{
+
+    namespace assets
+    {
+
+        // a line aligned slice of the file and the attribute counts defined before it
+        struct objChunk
+        {
+            uint64_t offset;
+            uint64_t size;
+            size_t positionsBefore;
+            size_t normalsBefore;
+            size_t texcoordsBefore;
+        };
+
+        struct objAttributes
+        {
+            std::vector<float> positions;
+            std::vector<float> normals;
+            std::vector<float> texcoords;
+        };
+
+        struct objCorner
+        {
+            int64_t position;
+            int64_t texcoord;
+            int64_t normal;
+        };
+
+        // vertices of a chunk between two o / g / usemtl lines, the first one continues the previous chunk
+        struct objSegment
+        {
+            bool setsName = false;
+            std::string name;
+            bool setsMaterial = false;
+            std::string material;
+            size_t vertexCount = 0;
+            float boundsMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+            float boundsMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+        };
+
+        struct objChunkResult
+        {
+            objAttributes attributes;
+            std::vector<Vertex> vertices;
+            std::vector<objSegment> segments;
+            std::vector<std::string> materialLibraries;
+            size_t faces = 0;
+            std::string error;
+        };
+
+        static const char* skipSpace(const char* p, const char* end)
+        {
+            while (p < end && (*p == ' ' || *p == '\t'))
+                p++;
+            return p;
+        }
+
+        static const char* nextLine(const char* p, const char* end)
+        {
+            const char* newline = (const char*) memchr(p, '\n', end - p);
+            return newline ? newline + 1 : end;
+        }
+
+        // rest of the line without the trailing whitespace
+        static std::string readName(const char* p, const char* end)
+        {
+            p = skipSpace(p, end);
+            while (end > p && (end[-1] == '\n' || end[-1] == '\r' || end[-1] == ' ' || end[-1] == '\t'))
+                end--;
+            return std::string(p, end);
+        }
+
+        static void growBounds(float* boundsMin, float* boundsMax, const float* min, const float* max)
+        {
+            for (int i = 0; i < 3; i++)
+            {
+                boundsMin[i] = std::min(boundsMin[i], min[i]);
+                boundsMax[i] = std::max(boundsMax[i], max[i]);
+            }
+        }
+
+        static const char* parseFloat(const char* p, const char* end, float& value)
+        {
+            p = skipSpace(p, end);
+            if (p < end && *p == '+')
+                p++;
+
+            auto result = std::from_chars(p, end, value);
+            if (result.ec != std::errc())
+            {
+                value = 0.0f;
+                return p;
+            }
+            return result.ptr;
+        }
+
+        static const char* parseIndex(const char* p, const char* end, int64_t& value)
+        {
+            auto result = std::from_chars(p, end, value);
+            if (result.ec != std::errc())
+            {
+                value = 0;
+                return p;
+            }
+            return result.ptr;
+        }
+
+        /* OBJ indices are one based, negative values count back from the last element defined so far
+        * positive ones may point forward so they are checked against the whole file
+        */
+        static bool resolveIndex(int64_t index, size_t defined, size_t total, int64_t& resolved)
+        {
+            if (index > 0)
+                resolved = index - 1;
+            else if (index < 0)
+                resolved = (int64_t) defined + index;
+            else
+                return false;
+
+            return resolved >= 0 && (size_t) resolved < total;
+        }
+
+        static bool isKeyword(const char* p, const char* end, const char* keyword, size_t length)
+        {
+            return (size_t) (end - p) > length && memcmp(p, keyword, length) == 0 && (p[length] == ' ' || p[length] == '\t');
+        }
+
+        static void parseAttributes(const char* p, const char* end, objChunkResult& result)
+        {
+            while (p < end)
+            {
+                const char* lineEnd = nextLine(p, end);
+                p = skipSpace(p, lineEnd);
+
+                if (isKeyword(p, lineEnd, "v", 1))
+                {
+                    p += 1;
+                    for (int i = 0; i < 3; i++)
+                    {
+                        float value;
+                        p = parseFloat(p, lineEnd, value);
+                        result.attributes.positions.push_back(value);
+                    }
+                }
+                else if (isKeyword(p, lineEnd, "vn", 2))
+                {
+                    p += 2;
+                    for (int i = 0; i < 3; i++)
+                    {
+                        float value;
+                        p = parseFloat(p, lineEnd, value);
+                        result.attributes.normals.push_back(value);
+                    }
+                }
+                else if (isKeyword(p, lineEnd, "vt", 2))
+                {
+                    p += 2;
+                    for (int i = 0; i < 2; i++)
+                    {
+                        float value;
+                        p = parseFloat(p, lineEnd, value);
+                        result.attributes.texcoords.push_back(value);
+                    }
+                }
+
+                p = lineEnd;
+            }
+        }
+
+        static void emitTriangle(const objAttributes& attributes, const objCorner* corners, const objParseOptions& options, std::vector<Vertex>& vertices)
+        {
+            // faces without normals get their flat face normal
+            float faceNormal[3] = { 0.0f, 0.0f, 0.0f };
+            if (corners[0].normal < 0 || corners[1].normal < 0 || corners[2].normal < 0)
+            {
+                const float* a = &attributes.positions[3 * corners[0].position];
+                const float* b = &attributes.positions[3 * corners[1].position];
+                const float* c = &attributes.positions[3 * corners[2].position];
+
+                float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+                float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+
+                faceNormal[0] = e1[1] * e2[2] - e1[2] * e2[1];
+                faceNormal[1] = e1[2] * e2[0] - e1[0] * e2[2];
+                faceNormal[2] = e1[0] * e2[1] - e1[1] * e2[0];
+
+                float length = std::sqrt(faceNormal[0] * faceNormal[0] + faceNormal[1] * faceNormal[1] + faceNormal[2] * faceNormal[2]);
+                if (length > 0.0f)
+                {
+                    for (int i = 0; i < 3; i++)
+                        faceNormal[i] /= length;
+                }
+            }
+
+            for (int v = 0; v < 3; v++)
+            {
+                const objCorner& corner = corners[v];
+
+                Vertex vertex;
+                memcpy(vertex.position, &attributes.positions[3 * corner.position], sizeof(vertex.position));
+
+                if (corner.normal >= 0)
+                    memcpy(vertex.normal, &attributes.normals[3 * corner.normal], sizeof(vertex.normal));
+                else
+                    memcpy(vertex.normal, faceNormal, sizeof(vertex.normal));
+
+                memcpy(vertex.color, vertex.normal, sizeof(vertex.color));
+
+                if (corner.texcoord >= 0)
+                {
+                    vertex.uv[0] = attributes.texcoords[2 * corner.texcoord + 0];
+                    vertex.uv[1] = attributes.texcoords[2 * corner.texcoord + 1];
+                }
+                else
+                {
+                    vertex.uv[0] = 0.0f;
+                    vertex.uv[1] = 0.0f;
+                }
+
+                if (options.flipTexcoordV)
+                    vertex.uv[1] = 1.0f - vertex.uv[1];
+
+                vertices.push_back(vertex);
+            }
+        }
+
+        static void parseFaces(const char* p, const char* end, const objChunk& chunk, const objAttributes& attributes, const objParseOptions& options, objChunkResult& result)
+        {
+            // attribute counts at the current line, needed for relative indices
+            size_t positions = chunk.positionsBefore;
+            size_t normals = chunk.normalsBefore;
+            size_t texcoords = chunk.texcoordsBefore;
+
+            std::vector<objCorner> corners;
+            result.segments.emplace_back();
+
+            while (p < end)
+            {
+                const char* lineEnd = nextLine(p, end);
+                p = skipSpace(p, lineEnd);
+
+                if (isKeyword(p, lineEnd, "v", 1))
+                {
+                    positions++;
+                }
+                else if (isKeyword(p, lineEnd, "vn", 2))
+                {
+                    normals++;
+                }
+                else if (isKeyword(p, lineEnd, "vt", 2))
+                {
+                    texcoords++;
+                }
+                else if (isKeyword(p, lineEnd, "o", 1) || isKeyword(p, lineEnd, "g", 1))
+                {
+                    objSegment& segment = result.segments.emplace_back();
+                    segment.setsName = true;
+                    segment.name = readName(p + 1, lineEnd);
+                }
+                else if (isKeyword(p, lineEnd, "usemtl", 6))
+                {
+                    objSegment& segment = result.segments.emplace_back();
+                    segment.setsMaterial = true;
+                    segment.material = readName(p + 6, lineEnd);
+                }
+                else if (isKeyword(p, lineEnd, "mtllib", 6))
+                {
+                    result.materialLibraries.push_back(readName(p + 6, lineEnd));
+                }
+                else if (isKeyword(p, lineEnd, "f", 1))
+                {
+                    p += 1;
+                    corners.clear();
+
+                    bool valid = true;
+                    while (true)
+                    {
+                        p = skipSpace(p, lineEnd);
+                        if (p >= lineEnd || *p == '\r' || *p == '\n' || *p == '#')
+                            break;
+
+                        // v, v/vt, v//vn or v/vt/vn
+                        int64_t index[3] = { 0, 0, 0 };
+                        p = parseIndex(p, lineEnd, index[0]);
+                        for (int i = 1; i < 3 && p < lineEnd && *p == '/'; i++)
+                        {
+                            p++;
+                            if (p < lineEnd && *p != '/')
+                                p = parseIndex(p, lineEnd, index[i]);
+                        }
+
+                        objCorner corner{ -1, -1, -1 };
+                        valid &= resolveIndex(index[0], positions, attributes.positions.size() / 3, corner.position);
+                        if (index[1] != 0)
+                            valid &= resolveIndex(index[1], texcoords, attributes.texcoords.size() / 2, corner.texcoord);
+                        if (index[2] != 0)
+                            valid &= resolveIndex(index[2], normals, attributes.normals.size() / 3, corner.normal);
+
+                        // skip whatever token we failed to read
+                        while (p < lineEnd && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n')
+                            p++;
+
+                        corners.push_back(corner);
+                    }
+
+                    if (!valid || corners.size() < 3)
+                    {
+                        if (result.error.empty())
+                            result.error = "invalid face at byte " + std::to_string(chunk.offset);
+                    }
+                    else
+                    {
+                        size_t firstVertex = result.vertices.size();
+
+                        // triangulate as a fan
+                        for (size_t i = 1; i + 1 < corners.size(); i++)
+                        {
+                            objCorner triangle[3] = { corners[0], corners[i], corners[i + 1] };
+                            emitTriangle(attributes, triangle, options, result.vertices);
+                        }
+                        result.faces++;
+
+                        objSegment& segment = result.segments.back();
+                        segment.vertexCount += result.vertices.size() - firstVertex;
+                        for (size_t v = firstVertex; v < result.vertices.size(); v++)
+                            growBounds(segment.boundsMin, segment.boundsMax, result.vertices[v].position, result.vertices[v].position);
+                    }
+                }
+
+                p = lineEnd;
+            }
+        }
+
+        // read the next line aligned chunk, the tail after the last newline is carried over
+        static bool readChunk(std::ifstream& file, const objParseOptions& options, std::string& carry, uint64_t& offset, objChunk& chunk, std::string& text)
+        {
+            text = std::move(carry);
+            carry.clear();
+
+            while (file)
+            {
+                size_t oldSize = text.size();
+                text.resize(oldSize + options.chunkSize);
+                file.read(text.data() + oldSize, options.chunkSize);
+                text.resize(oldSize + (size_t) file.gcount());
+
+                size_t lastNewline = text.rfind('\n');
+                if (lastNewline != std::string::npos && text.size() >= options.chunkSize)
+                {
+                    carry.assign(text, lastNewline + 1, std::string::npos);
+                    text.resize(lastNewline + 1);
+                    break;
+                }
+            }
+
+            if (text.empty())
+                return false;
+
+            chunk.offset = offset;
+            chunk.size = text.size();
+            offset += text.size();
+
+            return true;
+        }
+
+        bool parseObj(const char* path, const objParseOptions& options, const objVertexSink& sink, objLayout& layout, objStats& stats, std::string& error)
+        {
+            std::ifstream file(path, std::ios::binary | std::ios::in);
+            if (!file.is_open())
+            {
+                error = "failed to open " + std::string(path);
+                return false;
+            }
+
+            unsigned int workers = options.workers ? options.workers : default_worker_count();
+
+            objAttributes attributes;
+            std::vector<objChunk> chunks;
+            std::vector<std::string> texts(workers);
+            std::vector<objChunkResult> results(workers);
+
+            // first pass: chunk the file and gather every attribute
+            std::string carry;
+            uint64_t offset = 0;
+            bool more = true;
+
+            while (more)
+            {
+                size_t count = 0;
+                size_t firstChunk = chunks.size();
+
+                for (; count < workers; count++)
+                {
+                    objChunk chunk{};
+                    if (!readChunk(file, options, carry, offset, chunk, texts[count]))
+                    {
+                        more = false;
+                        break;
+                    }
+                    chunks.push_back(chunk);
+                }
+
+                parallel_for(count, [&](size_t i)
+                {
+                    results[i] = objChunkResult{};
+                    parseAttributes(texts[i].data(), texts[i].data() + texts[i].size(), results[i]);
+                }, workers);
+
+                for (size_t i = 0; i < count; i++)
+                {
+                    objChunk& chunk = chunks[firstChunk + i];
+                    chunk.positionsBefore = attributes.positions.size() / 3;
+                    chunk.normalsBefore = attributes.normals.size() / 3;
+                    chunk.texcoordsBefore = attributes.texcoords.size() / 2;
+
+                    const objAttributes& local = results[i].attributes;
+                    attributes.positions.insert(attributes.positions.end(), local.positions.begin(), local.positions.end());
+                    attributes.normals.insert(attributes.normals.end(), local.normals.begin(), local.normals.end());
+                    attributes.texcoords.insert(attributes.texcoords.end(), local.texcoords.begin(), local.texcoords.end());
+
+                    results[i].attributes = objAttributes{};
+                }
+            }
+
+            stats.positions = attributes.positions.size() / 3;
+            stats.normals = attributes.normals.size() / 3;
+            stats.texcoords = attributes.texcoords.size() / 2;
+
+            // second pass: triangulate the faces of each chunk and stream them out in order
+            file.clear();
+
+            objGroup group;
+            std::fill(group.boundsMin, group.boundsMin + 3, FLT_MAX);
+            std::fill(group.boundsMax, group.boundsMax + 3, -FLT_MAX);
+
+            for (size_t first = 0; first < chunks.size(); first += workers)
+            {
+                size_t count = std::min<size_t>(workers, chunks.size() - first);
+
+                for (size_t i = 0; i < count; i++)
+                {
+                    const objChunk& chunk = chunks[first + i];
+                    texts[i].resize(chunk.size);
+                    file.seekg(chunk.offset);
+                    file.read(texts[i].data(), chunk.size);
+                }
+
+                parallel_for(count, [&](size_t i)
+                {
+                    results[i] = objChunkResult{};
+                    parseFaces(texts[i].data(), texts[i].data() + texts[i].size(), chunks[first + i], attributes, options, results[i]);
+                }, workers);
+
+                for (size_t i = 0; i < count; i++)
+                {
+                    objChunkResult& result = results[i];
+
+                    if (!result.error.empty() && error.empty())
+                        error = result.error;
+
+                    // stitch the segments onto the groups of the previous chunks
+                    for (const objSegment& segment : result.segments)
+                    {
+                        if ((segment.setsName || segment.setsMaterial) && group.vertexCount > 0)
+                        {
+                            layout.groups.push_back(group);
+
+                            group.firstVertex += group.vertexCount;
+                            group.vertexCount = 0;
+                            std::fill(group.boundsMin, group.boundsMin + 3, FLT_MAX);
+                            std::fill(group.boundsMax, group.boundsMax + 3, -FLT_MAX);
+                        }
+
+                        // usemtl stays in effect across o / g lines, like in other OBJ readers
+                        if (segment.setsName)
+                            group.name = segment.name;
+                        if (segment.setsMaterial)
+                            group.material = segment.material;
+
+                        group.vertexCount += segment.vertexCount;
+                        growBounds(group.boundsMin, group.boundsMax, segment.boundsMin, segment.boundsMax);
+                    }
+
+                    layout.materialLibraries.insert(layout.materialLibraries.end(), result.materialLibraries.begin(), result.materialLibraries.end());
+
+                    stats.faces += result.faces;
+                    stats.vertices += result.vertices.size();
+
+                    if (!result.vertices.empty())
+                        sink(result.vertices.data(), result.vertices.size());
+
+                    result.vertices = std::vector<Vertex>{};
+                }
+            }
+
+            if (group.vertexCount > 0)
+                layout.groups.push_back(group);
+
+            stats.shapes = layout.groups.size();
+
+            return error.empty();
+        }
+
+        bool parseMtl(const char* path, std::vector<objMaterial>& materials, std::string& error)
+        {
+            std::ifstream file(path, std::ios::binary | std::ios::in);
+            if (!file.is_open())
+            {
+                error = "failed to open " + std::string(path);
+                return false;
+            }
+
+            std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            const char* p = text.data();
+            const char* end = text.data() + text.size();
+
+            while (p < end)
+            {
+                const char* lineEnd = nextLine(p, end);
+                p = skipSpace(p, lineEnd);
+
+                if (isKeyword(p, lineEnd, "newmtl", 6))
+                {
+                    objMaterial& material = materials.emplace_back();
+                    material.name = readName(p + 6, lineEnd);
+                }
+                else if (!materials.empty() && isKeyword(p, lineEnd, "Kd", 2))
+                {
+                    p += 2;
+                    for (int i = 0; i < 3; i++)
+                        p = parseFloat(p, lineEnd, materials.back().diffuse[i]);
+                }
+                else if (!materials.empty() && isKeyword(p, lineEnd, "map_Kd", 6))
+                {
+                    // options before the file name are not supported, the last token is taken as the path
+                    std::string map = readName(p + 6, lineEnd);
+                    size_t split = map.find_last_of(" \t");
+                    materials.back().diffuseTexture = split == std::string::npos ? map : map.substr(split + 1);
+                }
+
+                p = lineEnd;
+            }
+
+            return true;
+        }
+    }
+
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "VkEngine/Asset/Asset.h"
+
+namespace vk_engine
+{
+
+    namespace assets
+    {
+
+        struct objParseOptions
+        {
+            size_t chunkSize = 16 << 20; // bytes of text handed to one worker at a time
+            unsigned int workers = 0; // 0 uses one per core
+            bool flipTexcoordV = true;
+        };
+
+        struct objStats
+        {
+            size_t positions = 0;
+            size_t normals = 0;
+            size_t texcoords = 0;
+            size_t faces = 0;
+            size_t vertices = 0; // triangle vertices emitted
+            size_t shapes = 0; // non empty groups
+        };
+
+        // a run of the vertex stream sharing one object name and material, split on o / g / usemtl
+        struct objGroup
+        {
+            std::string name;
+            std::string material; // empty when no usemtl applies
+            size_t firstVertex = 0;
+            size_t vertexCount = 0;
+            float boundsMin[3];
+            float boundsMax[3];
+        };
+
+        struct objLayout
+        {
+            std::vector<objGroup> groups;
+            std::vector<std::string> materialLibraries; // mtllib paths as written in the file
+        };
+
+        struct objMaterial
+        {
+            std::string name;
+            float diffuse[3] = { 1.0f, 1.0f, 1.0f };
+            std::string diffuseTexture;
+        };
+
+        // receives the triangulated vertex stream in file order
+        using objVertexSink = std::function<void(const Vertex* vertices, size_t count)>;
+
+        /* parse an OBJ in two streaming passes over line aligned chunks,
+        * the first collects the vertex attributes, the second triangulates the faces
+        * peak memory is the attribute arrays plus one chunk of text and vertices per worker
+        */
+        bool parseObj(const char* path, const objParseOptions& options, const objVertexSink& sink, objLayout& layout, objStats& stats, std::string& error);
+
+        // read newmtl entries of a material library, only the diffuse colour and map are kept
+        bool parseMtl(const char* path, std::vector<objMaterial>& materials, std::string& error);
+    }
+
+}
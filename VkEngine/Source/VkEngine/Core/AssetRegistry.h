@@ -0,0 +1,258 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace vk_engine
+{
+
+    /* interned name of a registry entry, the low bits pick the shard and the rest the entry inside it
+    * the generation is bumped whenever an entry is removed so handles to unloaded assets stop resolving
+    */
+    struct AssetHandle
+    {
+        uint32_t index{ UINT32_MAX };
+        uint32_t generation{ 0 };
+
+        bool operator==(const AssetHandle& other) const { return index == other.index && generation == other.generation; }
+    };
+
+    enum class AssetState
+    {
+        MISSING, // never acquired, or released to zero
+        LOADING,
+        READY,
+        FAILED
+    };
+
+    /* assets by name with reference counts, safe to use from any thread
+    * entries live in shards with a lock each, so loaders publishing different assets rarely wait on each other
+    * an entry is removed when its last reference is released, its value is handed back to the caller
+    * to be destroyed once nothing on the gpu uses it anymore
+    */
+    template<typename T>
+    class AssetRegistry
+    {
+    public:
+        static constexpr uint32_t SHARD_BITS = 4;
+        static constexpr uint32_t SHARD_COUNT = 1u << SHARD_BITS;
+
+        // takes a reference, an unknown name gets a LOADING entry and inserted tells the caller to load it
+        AssetHandle acquire(const std::string& name, bool* inserted = nullptr)
+        {
+            Shard& shard = _shards[shard_of(name)];
+            std::unique_lock<std::shared_mutex> lock(shard.mutex);
+
+            auto it = shard.names.find(name);
+            if (it != shard.names.end())
+            {
+                Entry& entry = shard.entries[it->second];
+                entry.references++;
+
+                if (inserted)
+                    *inserted = false;
+
+                return make_handle(shard_of(name), it->second, entry.generation);
+            }
+
+            uint32_t entryIndex;
+            if (!shard.freeEntries.empty())
+            {
+                entryIndex = shard.freeEntries.back();
+                shard.freeEntries.pop_back();
+            }
+            else
+            {
+                entryIndex = (uint32_t) shard.entries.size();
+                shard.entries.emplace_back();
+            }
+
+            Entry& entry = shard.entries[entryIndex];
+            entry.name = name;
+            entry.state = AssetState::LOADING;
+            entry.references = 1;
+
+            shard.names.emplace(name, entryIndex);
+
+            if (inserted)
+                *inserted = true;
+
+            return make_handle(shard_of(name), entryIndex, entry.generation);
+        }
+
+        // one more reference to an entry the caller already holds
+        void acquire(AssetHandle handle)
+        {
+            Shard& shard = _shards[handle.index & (SHARD_COUNT - 1)];
+            std::unique_lock<std::shared_mutex> lock(shard.mutex);
+
+            if (Entry* entry = find_entry(shard, handle))
+                entry->references++;
+        }
+
+        /* drops a reference, true when it was the last one and retired holds the loaded value
+        * an entry released while still loading is dropped, its loader sees publish fail
+        */
+        bool release(AssetHandle handle, T& retired)
+        {
+            Shard& shard = _shards[handle.index & (SHARD_COUNT - 1)];
+            std::unique_lock<std::shared_mutex> lock(shard.mutex);
+
+            Entry* entry = find_entry(shard, handle);
+            if (!entry || --entry->references > 0)
+                return false;
+
+            bool ready = entry->state == AssetState::READY;
+            if (ready)
+                retired = std::move(entry->value);
+
+            shard.names.erase(entry->name);
+            shard.freeEntries.push_back(handle.index >> SHARD_BITS);
+
+            entry->name.clear();
+            entry->value = T{};
+            entry->state = AssetState::MISSING;
+            entry->generation++;
+
+            return ready;
+        }
+
+        // LOADING to READY, false when the entry was released meanwhile and the caller still owns value
+        bool publish(AssetHandle handle, T&& value)
+        {
+            Shard& shard = _shards[handle.index & (SHARD_COUNT - 1)];
+            std::unique_lock<std::shared_mutex> lock(shard.mutex);
+
+            Entry* entry = find_entry(shard, handle);
+            if (!entry || entry->state != AssetState::LOADING)
+                return false;
+
+            entry->value = std::move(value);
+            entry->state = AssetState::READY;
+            return true;
+        }
+
+        void fail(AssetHandle handle)
+        {
+            Shard& shard = _shards[handle.index & (SHARD_COUNT - 1)];
+            std::unique_lock<std::shared_mutex> lock(shard.mutex);
+
+            if (Entry* entry = find_entry(shard, handle))
+                entry->state = AssetState::FAILED;
+        }
+
+        AssetState state(AssetHandle handle) const
+        {
+            const Shard& shard = _shards[handle.index & (SHARD_COUNT - 1)];
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+
+            const Entry* entry = find_entry(shard, handle);
+            return entry ? entry->state : AssetState::MISSING;
+        }
+
+        // null unless READY, the value stays at its address until the last reference is released
+        T* get(AssetHandle handle)
+        {
+            Shard& shard = _shards[handle.index & (SHARD_COUNT - 1)];
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+
+            Entry* entry = find_entry(shard, handle);
+            return entry && entry->state == AssetState::READY ? &entry->value : nullptr;
+        }
+
+        // handle of a live entry without taking a reference
+        AssetHandle find(const std::string& name) const
+        {
+            const Shard& shard = _shards[shard_of(name)];
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+
+            auto it = shard.names.find(name);
+            if (it == shard.names.end())
+                return {};
+
+            return make_handle(shard_of(name), it->second, shard.entries[it->second].generation);
+        }
+
+        size_t size() const
+        {
+            size_t count = 0;
+            for (const Shard& shard : _shards)
+            {
+                std::shared_lock<std::shared_mutex> lock(shard.mutex);
+                count += shard.names.size();
+            }
+            return count;
+        }
+
+        // hands every loaded value to func and empties the registry whatever the reference counts, for shutdown
+        void clear(const std::function<void(T&)>& func)
+        {
+            for (Shard& shard : _shards)
+            {
+                std::unique_lock<std::shared_mutex> lock(shard.mutex);
+
+                for (Entry& entry : shard.entries)
+                {
+                    if (entry.state == AssetState::READY)
+                        func(entry.value);
+                }
+
+                shard.names.clear();
+                shard.entries.clear();
+                shard.freeEntries.clear();
+            }
+        }
+
+    private:
+        struct Entry
+        {
+            std::string name;
+            T value{};
+            AssetState state{ AssetState::MISSING };
+            uint32_t references{ 0 };
+            uint32_t generation{ 0 };
+        };
+
+        // a deque so entries never move while other threads hold pointers from get
+        struct Shard
+        {
+            mutable std::shared_mutex mutex;
+            std::unordered_map<std::string, uint32_t> names;
+            std::deque<Entry> entries;
+            std::vector<uint32_t> freeEntries;
+        };
+
+        Shard _shards[SHARD_COUNT];
+
+        static uint32_t shard_of(const std::string& name)
+        {
+            return (uint32_t) (std::hash<std::string>{}(name) & (SHARD_COUNT - 1));
+        }
+
+        static AssetHandle make_handle(uint32_t shard, uint32_t entry, uint32_t generation)
+        {
+            return { (entry << SHARD_BITS) | shard, generation };
+        }
+
+        static Entry* find_entry(Shard& shard, AssetHandle handle)
+        {
+            uint32_t entryIndex = handle.index >> SHARD_BITS;
+            if (handle.index == UINT32_MAX || entryIndex >= shard.entries.size())
+                return nullptr;
+
+            Entry& entry = shard.entries[entryIndex];
+            return entry.generation == handle.generation && entry.state != AssetState::MISSING ? &entry : nullptr;
+        }
+
+        static const Entry* find_entry(const Shard& shard, AssetHandle handle)
+        {
+            return find_entry(const_cast<Shard&>(shard), handle);
+        }
+    };
+
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <thread>
+#include <vector>
+
+namespace vk_engine
+{
+
+    // number of workers used when the caller does not ask for a specific count
+    inline unsigned int default_worker_count()
+    {
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    /* run func(i) for every i in [0, count) on a pool of std::async workers,
+    * indices are handed out one at a time so uneven work items balance themselves
+    * exceptions thrown by func are rethrown on the calling thread
+    */
+    template<typename Func>
+    void parallel_for(size_t count, Func&& func, unsigned int workerCount = 0)
+    {
+        if (count == 0)
+            return;
+
+        if (workerCount == 0)
+            workerCount = default_worker_count();
+
+        workerCount = (unsigned int) std::min<size_t>(workerCount, count);
+
+        std::atomic<size_t> next{ 0 };
+        std::vector<std::future<void>> workers;
+        workers.reserve(workerCount);
+
+        for (unsigned int w = 0; w < workerCount; w++)
+        {
+            workers.push_back(std::async(std::launch::async, [&]()
+            {
+                for (size_t i = next++; i < count; i = next++)
+                {
+                    func(i);
+                }
+            }));
+        }
+
+        for (auto& worker : workers)
+        {
+            worker.get();
+        }
+    }
+
+}
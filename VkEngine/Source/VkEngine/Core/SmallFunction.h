@@ -0,0 +1,116 @@
+#pragma once
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace vk_engine
+{
+
+    template<typename Signature, size_t Capacity = 48>
+    class SmallFunction;
+
+    /* a move only callable stored inline, for callbacks queued in bulk where std::function would allocate
+    * callables larger than Capacity don't compile instead of silently falling back to the heap
+    */
+    template<typename R, typename... Args, size_t Capacity>
+    class SmallFunction<R(Args...), Capacity>
+    {
+    public:
+        SmallFunction() = default;
+
+        template<typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, SmallFunction>>>
+        SmallFunction(F&& func)
+        {
+            using Callable = std::decay_t<F>;
+            static_assert(sizeof(Callable) <= Capacity, "callable too large for SmallFunction, capture handles instead of whole objects");
+            static_assert(alignof(Callable) <= alignof(std::max_align_t), "callable over aligned for SmallFunction");
+            static_assert(std::is_nothrow_move_constructible_v<Callable>, "SmallFunction moves its callable without exceptions");
+
+            new (_storage) Callable(std::forward<F>(func));
+            _ops = ops_for<Callable>();
+        }
+
+        SmallFunction(SmallFunction&& other) noexcept
+        {
+            move_from(other);
+        }
+
+        SmallFunction& operator=(SmallFunction&& other) noexcept
+        {
+            if (this != &other)
+            {
+                reset();
+                move_from(other);
+            }
+            return *this;
+        }
+
+        SmallFunction(const SmallFunction&) = delete;
+        SmallFunction& operator=(const SmallFunction&) = delete;
+
+        ~SmallFunction()
+        {
+            reset();
+        }
+
+        explicit operator bool() const { return _ops != nullptr; }
+
+        R operator()(Args... args)
+        {
+            return _ops->invoke(_storage, std::forward<Args>(args)...);
+        }
+
+        void reset()
+        {
+            if (_ops)
+            {
+                _ops->destroy(_storage);
+                _ops = nullptr;
+            }
+        }
+
+    private:
+        struct Ops
+        {
+            R (*invoke)(void* callable, Args&&... args);
+            void (*move)(void* dest, void* src); // move constructs into dest and destroys src
+            void (*destroy)(void* callable);
+        };
+
+        template<typename Callable>
+        static const Ops* ops_for()
+        {
+            static const Ops ops{
+                [](void* callable, Args&&... args) -> R
+                {
+                    return (*static_cast<Callable*>(callable))(std::forward<Args>(args)...);
+                },
+                [](void* dest, void* src)
+                {
+                    new (dest) Callable(std::move(*static_cast<Callable*>(src)));
+                    static_cast<Callable*>(src)->~Callable();
+                },
+                [](void* callable)
+                {
+                    static_cast<Callable*>(callable)->~Callable();
+                }
+            };
+            return &ops;
+        }
+
+        void move_from(SmallFunction& other)
+        {
+            if (other._ops)
+            {
+                other._ops->move(_storage, other._storage);
+                _ops = other._ops;
+                other._ops = nullptr;
+            }
+        }
+
+        alignas(std::max_align_t) unsigned char _storage[Capacity];
+        const Ops* _ops{ nullptr };
+    };
+
+}
@@ -0,0 +1,130 @@
+#include "VkEngine/Renderer/Descriptor.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace vk_engine
+{
+
+	// descriptors per set reserved for each type, scaled by the number of sets in a pool
+	static const std::pair<VkDescriptorType, float> POOL_RATIOS[] =
+	{
+		{ VK_DESCRIPTOR_TYPE_SAMPLER, 0.5f },
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.0f },
+		{ VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 4.0f },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.0f },
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.0f },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.0f },
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1.0f }
+	};
+
+	// pools double in size as they are added, up to this many sets
+	static constexpr uint32_t MAX_SETS_PER_POOL = 4096;
+
+	void DescriptorAllocator::init(VkDevice device, uint32_t setsPerPool)
+	{
+		_device = device;
+		_setsPerPool = setsPerPool;
+	}
+
+	void DescriptorAllocator::cleanup()
+	{
+		for (VkDescriptorPool pool : _usedPools)
+		{
+			vkDestroyDescriptorPool(_device, pool, nullptr);
+		}
+
+		for (VkDescriptorPool pool : _freePools)
+		{
+			vkDestroyDescriptorPool(_device, pool, nullptr);
+		}
+
+		_usedPools.clear();
+		_freePools.clear();
+		_currentPool = VK_NULL_HANDLE;
+	}
+
+	VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout)
+	{
+		if (_currentPool == VK_NULL_HANDLE)
+		{
+			_currentPool = grab_pool();
+		}
+
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.pNext = nullptr;
+
+		allocInfo.descriptorPool = _currentPool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &layout;
+
+		VkDescriptorSet set;
+		VkResult result = vkAllocateDescriptorSets(_device, &allocInfo, &set);
+
+		// the pool is full, move on to the next one and try once more
+		if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL)
+		{
+			_currentPool = grab_pool();
+			allocInfo.descriptorPool = _currentPool;
+			result = vkAllocateDescriptorSets(_device, &allocInfo, &set);
+		}
+
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to allocate descriptor set!");
+		}
+
+		return set;
+	}
+
+	void DescriptorAllocator::reset_pools()
+	{
+		for (VkDescriptorPool pool : _usedPools)
+		{
+			vkResetDescriptorPool(_device, pool, 0);
+			_freePools.push_back(pool);
+		}
+
+		_usedPools.clear();
+		_currentPool = VK_NULL_HANDLE;
+	}
+
+	VkDescriptorPool DescriptorAllocator::grab_pool()
+	{
+		if (!_freePools.empty())
+		{
+			VkDescriptorPool pool = _freePools.back();
+			_freePools.pop_back();
+			_usedPools.push_back(pool);
+			return pool;
+		}
+
+		std::vector<VkDescriptorPoolSize> sizes;
+		for (const auto& [type, ratio] : POOL_RATIOS)
+		{
+			sizes.push_back({ type, std::max(1u, (uint32_t) (ratio * _setsPerPool)) });
+		}
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.pNext = nullptr;
+
+		poolInfo.flags = 0;
+		poolInfo.maxSets = _setsPerPool;
+		poolInfo.poolSizeCount = (uint32_t) sizes.size();
+		poolInfo.pPoolSizes = sizes.data();
+
+		VkDescriptorPool pool;
+		if (vkCreateDescriptorPool(_device, &poolInfo, nullptr, &pool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create descriptor pool!");
+		}
+
+		_usedPools.push_back(pool);
+		_setsPerPool = std::min(_setsPerPool * 2, MAX_SETS_PER_POOL);
+
+		return pool;
+	}
+
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include "vk_engine/renderer/vk_type.h"
+#include <vector>
+
+namespace vk_engine
+{
+
+	/* hands out descriptor sets from a list of pools, a new pool is created whenever the current one runs out
+	* sets are never freed one by one, reset_pools recycles every pool at once
+	* not thread safe, the same as the pools it wraps
+	*/
+	class DescriptorAllocator
+	{
+	public:
+		void init(VkDevice device, uint32_t setsPerPool = 64);
+		void cleanup();
+
+		VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+
+		// every set handed out so far becomes invalid, the pools are kept for reuse
+		void reset_pools();
+
+		size_t pool_count() const { return _usedPools.size() + _freePools.size(); }
+
+	private:
+		VkDevice _device{ VK_NULL_HANDLE };
+		uint32_t _setsPerPool{ 64 };
+
+		VkDescriptorPool _currentPool{ VK_NULL_HANDLE };
+		std::vector<VkDescriptorPool> _usedPools;
+		std::vector<VkDescriptorPool> _freePools;
+
+		VkDescriptorPool grab_pool();
+	};
+
+}
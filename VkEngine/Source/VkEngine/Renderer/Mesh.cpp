@@ -1,8 +1,9 @@
 #include "vk_engine/renderer/vk_mesh.h"
 #include "vk_engine/assets/assets.h"
+#include "vk_engine/core/logger.h"
 #include "vk_engine/renderer/vk_renderer.h"
 
-#include <iostream>
+#include <cfloat>
 #include <future>
 #include <mutex>
 
@@ -57,10 +58,21 @@ namespace vk_engine
 		return description;
 	}
 
-	void Mesh::load_from_obj(const char* filename, vk_renderer* renderer)
+	bool Mesh::load_from_obj(const char* filename, vk_renderer* renderer, Mesh& mesh)
 	{
 		assets::assetFile asset{};
-		assets::loadAssetFile(filename, asset);
+		if (!assets::loadAssetFile(filename, asset))
+		{
+			return false;
+		}
+
+#ifndef NDEBUG
+		// hashing the source is only worth it in development builds
+		if (assets::isAssetStale(filename, asset))
+		{
+			VK_LOG_WARN(std::string(filename) + " is out of date with its source, rerun VkAsset");
+		}
+#endif
 
 		assets::meshInfo info = assets::readMeshInfo(&asset);
 
@@ -83,49 +95,65 @@ namespace vk_engine
 		void* data;
 		vmaMapMemory(renderer->_allocator, stagingBuffer._allocation, &data);
 
-		std::cout << "compressed size: " << asset.binaryBlob.size() << std::endl;
-		std::cout << "dest size: " << info.meshSize << std::endl;
-
 		assets::unpackMesh(&info, asset.binaryBlob.data(), asset.binaryBlob.size(), (char*) data);
 
-		std::cout << "unpacked!" << std::endl;
-
 		vmaUnmapMemory(renderer->_allocator, stagingBuffer._allocation);
 
 		// allocate Vertex Buffer
 		VkBufferCreateInfo vertexBufferInfo{};
 		vertexBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 		// total size in bytes
-		vertexBufferInfo.size = asset.binaryBlob.size();
+		vertexBufferInfo.size = info.meshSize;
 		vertexBufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
 
 		// let vma know this buffer is gonna written by cpu and read by gpu
 		allocationInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
 
-		Mesh mesh;
-		mesh._vertices.resize(info.meshSize / sizeof(Vertex));
+		mesh._vertexCount = (uint32_t) (info.meshSize / sizeof(Vertex));
 
-		vmaCreateBuffer(renderer->_allocator, &vertexBufferInfo, &allocationInfo, &mesh._vertexBuffer._buffer, &mesh._vertexBuffer._allocation, nullptr);
+		for (const assets::submeshInfo& submeshInfo : info.submeshes)
+		{
+			Submesh submesh;
+			submesh.firstVertex = (uint32_t) submeshInfo.firstVertex;
+			submesh.vertexCount = (uint32_t) submeshInfo.vertexCount;
+			submesh.material = submeshInfo.material;
+			submesh.boundsMin = glm::vec3(submeshInfo.boundsMin[0], submeshInfo.boundsMin[1], submeshInfo.boundsMin[2]);
+			submesh.boundsMax = glm::vec3(submeshInfo.boundsMax[0], submeshInfo.boundsMax[1], submeshInfo.boundsMax[2]);
+			mesh._submeshes.push_back(submesh);
+		}
+
+		for (const assets::meshMaterial& material : info.materials)
+		{
+			mesh._materialNames.push_back(material.name);
+			mesh._materialColors.push_back(glm::vec3(material.diffuse[0], material.diffuse[1], material.diffuse[2]));
+		}
 
-		renderer->_deletionQueue.push_function([=]()
+		// older assets have no submesh table, treat the whole mesh as one part that is never culled
+		if (mesh._submeshes.empty())
 		{
-			vmaDestroyBuffer(renderer->_allocator, mesh._vertexBuffer._buffer, mesh._vertexBuffer._allocation);
-		});
+			Submesh submesh;
+			submesh.firstVertex = 0;
+			submesh.vertexCount = mesh._vertexCount;
+			submesh.material = 0;
+			submesh.boundsMin = glm::vec3(-FLT_MAX * 0.5f);
+			submesh.boundsMax = glm::vec3(FLT_MAX * 0.5f);
+			mesh._submeshes.push_back(submesh);
+		}
+
+		vmaCreateBuffer(renderer->_allocator, &vertexBufferInfo, &allocationInfo, &mesh._vertexBuffer._buffer, &mesh._vertexBuffer._allocation, nullptr);
 
-		renderer->immediate_submit([=](VkCommandBuffer cmd)
+		// the vertex buffer belongs to the caller, the renderer destroys it when the mesh is unloaded
+		renderer->immediate_submit([&](VkCommandBuffer cmd)
 		{
 			VkBufferCopy copy;
 			copy.srcOffset = 0;
 			copy.dstOffset = 0;
-			copy.size = asset.binaryBlob.size();
+			copy.size = info.meshSize;
 			vkCmdCopyBuffer(cmd, stagingBuffer._buffer, mesh._vertexBuffer._buffer, 1, &copy);
 		});
 
 		vmaDestroyBuffer(renderer->_allocator, stagingBuffer._buffer, stagingBuffer._allocation);
-
-		renderer->_meshes[filename] = std::move(mesh);
-
-		std::cout << "finished loading: " << filename << std::endl;
+		return true;
 	}
 
 }
\ No newline at end of file
@@ -28,13 +28,27 @@ namespace vk_engine
 		static VertexInputDescription get_vertex_description();
 	};
 
+	// vertex range of a mesh that is drawn and culled on its own
+	struct Submesh
+	{
+		uint32_t firstVertex;
+		uint32_t vertexCount;
+		uint32_t material; // index into Mesh::_materialNames
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+	};
+
 	struct Mesh
 	{
-		std::vector<Vertex> _vertices;
+		uint32_t _vertexCount{ 0 }; // the vertices only live in _vertexBuffer
+		std::vector<Submesh> _submeshes;
+		std::vector<std::string> _materialNames;
+		std::vector<glm::vec3> _materialColors; // diffuse colour from the source, per material name
 		// glm::mat4 transformMatrix;
 
 		AllocatedBuffer _vertexBuffer;
-		static void load_from_obj(const char* filename, struct vk_renderer* renderer);
+		// decompress and upload a mesh asset into mesh, false when the asset can't be read
+		static bool load_from_obj(const char* filename, struct vk_renderer* renderer, Mesh& mesh);
 	};
 
 }
\ No newline at end of file
@@ -0,0 +1,535 @@
+#include "VkEngine/Renderer/Pipeline.h"
+#include "VkEngine/Core/Parallel.h"
+#include "VkEngine/Asset/Hash.h"
+#include "vk_engine/renderer/vk_info.h"
+#include "vk_engine/renderer/vk_mesh.h"
+#include "vk_engine/core/logger.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace vk_engine
+{
+
+	static std::vector<char> readShader(const std::string& filename)
+	{
+		std::ifstream file(filename, std::ios::ate | std::ios::binary);
+
+		if (!file.is_open())
+		{
+			throw std::runtime_error("failed to open " + filename);
+		}
+
+		size_t filesize = (size_t)file.tellg();
+		std::vector<char> buffer(filesize);
+
+		file.seekg(0);
+		file.read(buffer.data(), filesize);
+
+		return buffer;
+	}
+
+	static VkShaderModule createShaderModule(VkDevice device, const std::vector<char>& code)
+	{
+		VkShaderModuleCreateInfo createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		createInfo.codeSize = code.size();
+		createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+		VkShaderModule shaderModule;
+		if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create shader module!");
+		}
+
+		return shaderModule;
+	}
+
+	VkPipeline PipelineBuilder::build_pipeline(VkDevice device, VkRenderPass pass, VkPipelineCache cache)
+	{
+		VkPipelineColorBlendStateCreateInfo colorBlending = vk_info::ColorBlendStateCreateInfo(_colorBlendAttachment);
+
+		VkGraphicsPipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+		pipelineInfo.stageCount = 2;
+		pipelineInfo.pStages = _shaderStages;
+		pipelineInfo.pVertexInputState = &_vertexInputInfo;
+		pipelineInfo.pInputAssemblyState = &_inputAssembly;
+		pipelineInfo.pViewportState = &_viewportState;
+		pipelineInfo.pRasterizationState = &_rasterizer;
+		pipelineInfo.pMultisampleState = &_multisampling;
+		pipelineInfo.pDepthStencilState = &_depthStencil;
+		pipelineInfo.pColorBlendState = &colorBlending;
+		pipelineInfo.pDynamicState = &_dynamicState;
+		pipelineInfo.layout = _pipelineLayout;
+		pipelineInfo.renderPass = pass;
+		pipelineInfo.subpass = 0;
+		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // optional
+		pipelineInfo.basePipelineIndex = -1; // optional
+
+		VkPipeline pipeline{};
+		if (vkCreateGraphicsPipelines(device, cache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create graphics pipeline!");
+		}
+
+		return pipeline;
+	}
+
+	bool PipelineState::operator==(const PipelineState& other) const
+	{
+		return memcmp(this, &other, sizeof(PipelineState)) == 0;
+	}
+
+	uint64_t PipelineState::hash() const
+	{
+		return assets::hash64(this, sizeof(PipelineState));
+	}
+
+	void PipelineRegistry::init(VkDevice device, VkPipelineCache cache, unsigned int workerCount)
+	{
+		_device = device;
+		_cache = cache;
+
+		if (workerCount == 0)
+			workerCount = default_worker_count();
+
+		for (unsigned int i = 0; i < workerCount; i++)
+		{
+			_workers.push_back(std::async(std::launch::async, [this]() { worker(); }));
+		}
+	}
+
+	void PipelineRegistry::cleanup()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stopping = true;
+			_queue.clear();
+		}
+
+		_queueReady.notify_all();
+
+		for (auto& worker : _workers)
+		{
+			worker.get();
+		}
+		_workers.clear();
+
+		for (const PipelineEntry& entry : _entries)
+		{
+			if (entry.pipeline != VK_NULL_HANDLE)
+				vkDestroyPipeline(_device, entry.pipeline, nullptr);
+		}
+
+		for (VkPipelineLayout layout : _layouts)
+		{
+			vkDestroyPipelineLayout(_device, layout, nullptr);
+		}
+
+		for (auto& [hash, setLayout] : _setLayoutCache)
+		{
+			vkDestroyDescriptorSetLayout(_device, setLayout, nullptr);
+		}
+
+		for (auto& [hash, module] : _shaders)
+		{
+			vkDestroyShaderModule(_device, module, nullptr);
+		}
+
+		_entries.clear();
+		_lookup.clear();
+		_layouts.clear();
+		_layoutLookup.clear();
+		_setLayouts.clear();
+		_setLayoutCache.clear();
+		_shaders.clear();
+		_reflections.clear();
+		_shaderPaths.clear();
+	}
+
+	uint64_t PipelineRegistry::register_shader(const std::string& path)
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			auto it = _shaderPaths.find(path);
+			if (it != _shaderPaths.end())
+				return it->second;
+		}
+
+		std::vector<char> code = readShader(path);
+		uint64_t hash = assets::hash64(code.data(), code.size());
+
+		ShaderReflection reflection;
+		std::string error;
+		if (!vk_reflect::reflect(reinterpret_cast<const uint32_t*>(code.data()), code.size() / sizeof(uint32_t), reflection, error))
+		{
+			throw std::runtime_error("failed to reflect " + path + ": " + error);
+		}
+
+		std::lock_guard<std::mutex> lock(_mutex);
+		_shaderPaths[path] = hash;
+
+		// the same SPIR-V under another path reuses the module
+		if (_shaders.find(hash) == _shaders.end())
+		{
+			_shaders[hash] = createShaderModule(_device, code);
+			_reflections[hash] = std::move(reflection);
+		}
+
+		return hash;
+	}
+
+	uint32_t PipelineRegistry::register_layout(uint64_t vertexShader, uint64_t fragmentShader, const std::vector<DescriptorOverride>& overrides)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		ShaderReflection reflection = _reflections.at(vertexShader);
+
+		std::string error;
+		if (!vk_reflect::merge(reflection, _reflections.at(fragmentShader), error))
+		{
+			throw std::runtime_error("failed to merge shader interfaces: " + error);
+		}
+
+		// bindings are sorted by set, so the last one tells how many sets the layout spans
+		uint32_t setCount = reflection.bindings.empty() ? 0 : reflection.bindings.back().set + 1;
+		std::vector<std::vector<VkDescriptorSetLayoutBinding>> setBindings(setCount);
+		std::vector<std::vector<VkDescriptorBindingFlags>> setFlags(setCount);
+
+		for (ReflectedBinding& binding : reflection.bindings)
+		{
+			VkDescriptorBindingFlags flags = 0;
+
+			for (const DescriptorOverride& descriptorOverride : overrides)
+			{
+				if (binding.set == descriptorOverride.set && binding.binding == descriptorOverride.binding)
+				{
+					binding.type = descriptorOverride.type;
+					if (descriptorOverride.count != 0)
+						binding.count = descriptorOverride.count;
+					flags = descriptorOverride.flags;
+				}
+			}
+
+			if (binding.count == 0)
+			{
+				throw std::runtime_error("set " + std::to_string(binding.set) + " binding " + std::to_string(binding.binding) + " is a runtime sized array and needs a count override");
+			}
+
+			VkDescriptorSetLayoutBinding layoutBinding = vk_info::DescriptorSetLayoutBinding(binding.type, binding.stages, binding.binding);
+			layoutBinding.descriptorCount = binding.count;
+			setBindings[binding.set].push_back(layoutBinding);
+			setFlags[binding.set].push_back(flags);
+		}
+
+		std::vector<VkDescriptorSetLayout> setLayouts;
+		for (uint32_t set = 0; set < setCount; set++)
+		{
+			setLayouts.push_back(create_set_layout(setBindings[set], setFlags[set]));
+		}
+
+		// set layouts are already unique, so their handles are enough to identify the pipeline layout
+		assets::hashState state;
+		assets::hashReset(state);
+		assets::hashUpdate(state, setLayouts.data(), setLayouts.size() * sizeof(VkDescriptorSetLayout));
+		assets::hashUpdate(state, reflection.pushConstants.data(), reflection.pushConstants.size() * sizeof(VkPushConstantRange));
+		uint64_t key = assets::hashDigest(state);
+
+		auto it = _layoutLookup.find(key);
+		if (it != _layoutLookup.end())
+			return it->second;
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo = vk_info::PipelineLayoutCreateInfo();
+
+		pipelineLayoutInfo.pPushConstantRanges = reflection.pushConstants.data();
+		pipelineLayoutInfo.pushConstantRangeCount = (uint32_t) reflection.pushConstants.size();
+		pipelineLayoutInfo.setLayoutCount = (uint32_t) setLayouts.size();
+		pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+
+		VkPipelineLayout layout;
+		if (vkCreatePipelineLayout(_device, &pipelineLayoutInfo, nullptr, &layout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create pipeline layout!");
+		}
+
+		_setLayouts.push_back(setLayouts);
+		_layouts.push_back(layout);
+
+		uint32_t id = (uint32_t) _layouts.size() - 1;
+		_layoutLookup[key] = id;
+
+		return id;
+	}
+
+	VkDescriptorSetLayout PipelineRegistry::set_layout(uint32_t layout, uint32_t set)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _setLayouts.at(layout).at(set);
+	}
+
+	VkDescriptorSetLayout PipelineRegistry::create_set_layout(const std::vector<VkDescriptorSetLayoutBinding>& bindings, const std::vector<VkDescriptorBindingFlags>& flags)
+	{
+		// hash the fields explicitly, immutable samplers are never used
+		std::vector<uint32_t> key;
+		bool updateAfterBind = false;
+		for (size_t i = 0; i < bindings.size(); i++)
+		{
+			const VkDescriptorSetLayoutBinding& binding = bindings[i];
+			key.insert(key.end(), { binding.binding, (uint32_t) binding.descriptorType, binding.descriptorCount, binding.stageFlags, flags[i] });
+			updateAfterBind |= (flags[i] & VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT) != 0;
+		}
+
+		uint64_t hash = assets::hash64(key.data(), key.size() * sizeof(uint32_t));
+
+		auto it = _setLayoutCache.find(hash);
+		if (it != _setLayoutCache.end())
+			return it->second;
+
+		VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo{};
+		flagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+		flagsInfo.bindingCount = (uint32_t) flags.size();
+		flagsInfo.pBindingFlags = flags.data();
+
+		VkDescriptorSetLayoutCreateInfo setInfo{};
+		setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		setInfo.pNext = &flagsInfo;
+
+		setInfo.bindingCount = (uint32_t) bindings.size();
+		setInfo.flags = updateAfterBind ? VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT : 0;
+		setInfo.pBindings = bindings.data();
+
+		VkDescriptorSetLayout setLayout;
+		if (vkCreateDescriptorSetLayout(_device, &setInfo, nullptr, &setLayout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create descriptor set layout!");
+		}
+
+		_setLayoutCache[hash] = setLayout;
+
+		return setLayout;
+	}
+
+	uint32_t PipelineRegistry::register_render_pass(VkRenderPass pass)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		for (uint32_t i = 0; i < _renderPasses.size(); i++)
+		{
+			if (_renderPasses[i] == pass)
+				return i;
+		}
+
+		_renderPasses.push_back(pass);
+
+		return (uint32_t) _renderPasses.size() - 1;
+	}
+
+	PipelineId PipelineRegistry::request(const PipelineState& state)
+	{
+		PipelineId id;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+
+			auto it = _lookup.find(state);
+			if (it != _lookup.end())
+				return it->second;
+
+			id = (PipelineId) _entries.size();
+			_entries.push_back(PipelineEntry{ state });
+			_lookup[state] = id;
+			_queue.push_back(id);
+		}
+
+		_queueReady.notify_one();
+
+		return id;
+	}
+
+	VkPipelineLayout PipelineRegistry::layout(PipelineId id)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _layouts[_entries[id].state.layout];
+	}
+
+	uint32_t PipelineRegistry::set_count(PipelineId id)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return (uint32_t) _setLayouts[_entries[id].state.layout].size();
+	}
+
+	VkPipeline PipelineRegistry::pipeline(PipelineId id)
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+
+		// still queued, no point waiting for a worker to get to it
+		if (_entries[id].status == BuildStatus::QUEUED)
+		{
+			_queue.erase(std::find(_queue.begin(), _queue.end(), id));
+			_entries[id].status = BuildStatus::BUILDING;
+
+			lock.unlock();
+			build(id);
+			lock.lock();
+		}
+
+		_pipelineReady.wait(lock, [&]() { return _entries[id].status == BuildStatus::READY || _entries[id].status == BuildStatus::FAILED; });
+
+		return _entries[id].pipeline;
+	}
+
+	VkPipeline PipelineRegistry::try_pipeline(PipelineId id)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _entries[id].pipeline;
+	}
+
+	size_t PipelineRegistry::pipeline_count()
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _entries.size();
+	}
+
+	void PipelineRegistry::worker()
+	{
+		while (true)
+		{
+			PipelineId id;
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_queueReady.wait(lock, [&]() { return _stopping || !_queue.empty(); });
+
+				if (_stopping)
+					return;
+
+				id = _queue.front();
+				_queue.pop_front();
+				_entries[id].status = BuildStatus::BUILDING;
+			}
+
+			build(id);
+		}
+	}
+
+	void PipelineRegistry::build(PipelineId id)
+	{
+		PipelineState state;
+		VkShaderModule vertShaderModule;
+		VkShaderModule fragShaderModule;
+		std::vector<ReflectedInput> inputs;
+		VkPipelineLayout layout;
+		VkRenderPass pass;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			state = _entries[id].state;
+			vertShaderModule = _shaders.at(state.vertexShader);
+			fragShaderModule = _shaders.at(state.fragmentShader);
+			inputs = _reflections.at(state.vertexShader).inputs;
+			layout = _layouts[state.layout];
+			pass = _renderPasses[state.renderPass];
+		}
+
+		// a failed pipeline is still marked finished so nobody waits on it forever
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		try
+		{
+			pipeline = compile(state, vertShaderModule, fragShaderModule, inputs, layout, pass);
+		}
+		catch (const std::exception& e)
+		{
+			VK_LOG_ERROR("failed to build pipeline " + assets::hashToString(state.hash()) + ": " + e.what());
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_entries[id].pipeline = pipeline;
+			_entries[id].status = pipeline != VK_NULL_HANDLE ? BuildStatus::READY : BuildStatus::FAILED;
+		}
+
+		_pipelineReady.notify_all();
+	}
+
+	VkPipeline PipelineRegistry::compile(const PipelineState& state, VkShaderModule vertShaderModule, VkShaderModule fragShaderModule, const std::vector<ReflectedInput>& inputs, VkPipelineLayout layout, VkRenderPass pass)
+	{
+		PipelineBuilder graphic_pipeline_info{};
+
+		VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
+		vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+		vertShaderStageInfo.module = vertShaderModule;
+		vertShaderStageInfo.pName = "main";
+
+		VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
+		fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+		fragShaderStageInfo.module = fragShaderModule;
+		fragShaderStageInfo.pName = "main";
+		VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
+
+		VertexInputDescription description = Vertex::get_vertex_description();
+
+		// only feed the attributes the vertex shader actually reads
+		std::vector<VkVertexInputAttributeDescription> attributes;
+		for (const ReflectedInput& input : inputs)
+		{
+			auto attribute = std::find_if(description.attributes.begin(), description.attributes.end(), [&](const VkVertexInputAttributeDescription& a) { return a.location == input.location; });
+
+			if (attribute == description.attributes.end())
+			{
+				throw std::runtime_error("vertex format has no attribute at location " + std::to_string(input.location));
+			}
+
+			if (attribute->format != input.format)
+			{
+				throw std::runtime_error("vertex format doesn't match the shader input at location " + std::to_string(input.location));
+			}
+
+			attributes.push_back(*attribute);
+		}
+		description.attributes = attributes;
+
+		VkPipelineVertexInputStateCreateInfo vertexInputInfo = vk_info::VertexInputStateCreateInfo(description.bindings, description.attributes);
+		VkPipelineInputAssemblyStateCreateInfo inputAssembly = vk_info::InputAssemblyStateCreateInfo((VkPrimitiveTopology) state.topology);
+		VkDynamicState DynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+		VkPipelineDynamicStateCreateInfo dynamicState{};
+		dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+		dynamicState.pNext = nullptr;
+		dynamicState.dynamicStateCount = 2;
+		dynamicState.pDynamicStates = DynamicStates;
+
+		VkPipelineViewportStateCreateInfo viewportState{};
+		viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+		viewportState.viewportCount = 1;
+		viewportState.pViewports = nullptr;
+		viewportState.scissorCount = 1;
+		viewportState.pScissors = nullptr;
+
+		VkPipelineRasterizationStateCreateInfo rasterizer = vk_info::RasterizationStateCreateInfo((VkPolygonMode) state.polygonMode);
+		rasterizer.cullMode = (VkCullModeFlags) state.cullMode;
+		rasterizer.frontFace = (VkFrontFace) state.frontFace;
+
+		VkPipelineColorBlendAttachmentState colorBlendAttachment = vk_info::ColorBlendAttachmentState();
+		if (state.alphaBlend)
+		{
+			colorBlendAttachment.blendEnable = VK_TRUE;
+			colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+			colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		}
+
+		graphic_pipeline_info._shaderStages = shaderStages;
+		graphic_pipeline_info._vertexInputInfo = vertexInputInfo;
+		graphic_pipeline_info._inputAssembly = inputAssembly;
+		graphic_pipeline_info._viewportState = viewportState;
+		graphic_pipeline_info._rasterizer = rasterizer;
+		graphic_pipeline_info._multisampling = vk_info::MultisampleStateCreateInfo();
+		graphic_pipeline_info._depthStencil = vk_info::PipelineDepthStencilStateCreateInfo(state.depthTest, state.depthWrite, (VkCompareOp) state.depthCompare);
+		graphic_pipeline_info._colorBlendAttachment = colorBlendAttachment;
+		graphic_pipeline_info._dynamicState = dynamicState;
+		graphic_pipeline_info._pipelineLayout = layout;
+
+		return graphic_pipeline_info.build_pipeline(_device, pass, _cache);
+	}
+
+}
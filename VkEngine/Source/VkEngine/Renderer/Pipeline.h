@@ -0,0 +1,161 @@
+#pragma once
+#include "vk_engine/renderer/vk_type.h"
+#include "VkEngine/Renderer/ShaderReflection.h"
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace vk_engine
+{
+
+	class PipelineBuilder
+	{
+	public:
+		VkPipelineShaderStageCreateInfo* _shaderStages;
+		VkPipelineVertexInputStateCreateInfo _vertexInputInfo;
+		VkPipelineInputAssemblyStateCreateInfo _inputAssembly;
+		// VkViewport _viewport;
+		// VkRect2D _scissor;
+		VkPipelineDynamicStateCreateInfo _dynamicState;
+		VkPipelineViewportStateCreateInfo _viewportState;
+		VkPipelineRasterizationStateCreateInfo _rasterizer;
+		VkPipelineColorBlendAttachmentState _colorBlendAttachment;
+		VkPipelineMultisampleStateCreateInfo _multisampling;
+		VkPipelineLayout _pipelineLayout;
+		VkPipelineDepthStencilStateCreateInfo _depthStencil;
+		VkPipeline build_pipeline(VkDevice device, VkRenderPass pass, VkPipelineCache cache = VK_NULL_HANDLE);
+	};
+
+	/* compact description of a graphics pipeline, plain bytes so it can be hashed and compared directly
+	* shaders are identified by the hash of their SPIR-V so the key stays stable between runs
+	*/
+	struct PipelineState
+	{
+		uint64_t vertexShader{ 0 }; // from PipelineRegistry::register_shader
+		uint64_t fragmentShader{ 0 };
+		uint32_t layout{ 0 }; // from PipelineRegistry::register_layout, must be built from the same two shaders
+		uint32_t renderPass{ 0 }; // from PipelineRegistry::register_render_pass
+		uint8_t vertexFormat{ 0 }; // only Vertex::get_vertex_description for now
+		uint8_t topology{ VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST };
+		uint8_t polygonMode{ VK_POLYGON_MODE_FILL };
+		uint8_t cullMode{ VK_CULL_MODE_NONE };
+		uint8_t frontFace{ VK_FRONT_FACE_COUNTER_CLOCKWISE };
+		uint8_t depthTest{ 1 };
+		uint8_t depthWrite{ 1 };
+		uint8_t depthCompare{ VK_COMPARE_OP_LESS };
+		uint8_t alphaBlend{ 0 };
+		uint8_t padding[7]{};
+
+		bool operator==(const PipelineState& other) const;
+		uint64_t hash() const;
+	};
+
+	static_assert(sizeof(PipelineState) == 40, "PipelineState must not contain implicit padding");
+
+	struct PipelineStateHash
+	{
+		size_t operator()(const PipelineState& state) const { return (size_t) state.hash(); }
+	};
+
+	using PipelineId = uint32_t;
+
+	// replaces what reflection can't know, e.g. a uniform buffer that is bound with a dynamic offset
+	struct DescriptorOverride
+	{
+		uint32_t set;
+		uint32_t binding;
+		VkDescriptorType type;
+		uint32_t count{ 0 }; // 0 keeps the count found in the shader, runtime sized arrays need one
+		VkDescriptorBindingFlags flags{ 0 }; // update after bind makes the set layout need an update after bind pool
+	};
+
+	/* owns every graphics pipeline, equal states share one VkPipeline
+	* new states are compiled on a pool of worker threads that all use the same VkPipelineCache,
+	* which the driver synchronizes internally
+	*/
+	class PipelineRegistry
+	{
+	public:
+		void init(VkDevice device, VkPipelineCache cache, unsigned int workerCount = 0);
+
+		// stop the workers and destroy every pipeline, layout and shader module
+		void cleanup();
+
+		// the module is created and reflected once per SPIR-V file, the returned hash identifies it in PipelineState
+		uint64_t register_shader(const std::string& path);
+
+		/* derive the descriptor set layouts and push constant ranges from the two registered shaders
+		* equal set layouts and equal pipeline layouts are created only once, sets the shaders skip get an empty layout
+		*/
+		uint32_t register_layout(uint64_t vertexShader, uint64_t fragmentShader, const std::vector<DescriptorOverride>& overrides = {});
+
+		// set layout of a registered pipeline layout, for allocating descriptor sets that are compatible with it
+		VkDescriptorSetLayout set_layout(uint32_t layout, uint32_t set);
+		uint32_t register_render_pass(VkRenderPass pass);
+
+		// returns the existing pipeline for an equal state, otherwise queues it for compilation
+		PipelineId request(const PipelineState& state);
+
+		VkPipelineLayout layout(PipelineId id);
+
+		// number of descriptor sets the pipeline's layout expects
+		uint32_t set_count(PipelineId id);
+
+		// blocks until the pipeline is built, building it on the calling thread if no worker took it yet
+		VkPipeline pipeline(PipelineId id);
+
+		// VK_NULL_HANDLE while the pipeline is still compiling or when it failed
+		VkPipeline try_pipeline(PipelineId id);
+
+		size_t pipeline_count();
+
+	private:
+		enum class BuildStatus
+		{
+			QUEUED,
+			BUILDING,
+			READY,
+			FAILED
+		};
+
+		struct PipelineEntry
+		{
+			PipelineState state;
+			BuildStatus status{ BuildStatus::QUEUED };
+			VkPipeline pipeline{ VK_NULL_HANDLE };
+		};
+
+		VkDevice _device{ VK_NULL_HANDLE };
+		VkPipelineCache _cache{ VK_NULL_HANDLE };
+
+		std::mutex _mutex;
+		std::condition_variable _queueReady;
+		std::condition_variable _pipelineReady;
+		bool _stopping{ false };
+
+		std::deque<PipelineEntry> _entries; // indexed by PipelineId
+		std::unordered_map<PipelineState, PipelineId, PipelineStateHash> _lookup;
+		std::deque<PipelineId> _queue;
+
+		std::unordered_map<std::string, uint64_t> _shaderPaths;
+		std::unordered_map<uint64_t, VkShaderModule> _shaders;
+		std::unordered_map<uint64_t, ShaderReflection> _reflections;
+		std::unordered_map<uint64_t, VkDescriptorSetLayout> _setLayoutCache; // keyed by the hash of the bindings
+		std::unordered_map<uint64_t, uint32_t> _layoutLookup; // keyed by the hash of set layouts and push constants
+		std::vector<std::vector<VkDescriptorSetLayout>> _setLayouts; // per pipeline layout
+		std::vector<VkPipelineLayout> _layouts;
+		std::vector<VkRenderPass> _renderPasses;
+
+		std::vector<std::future<void>> _workers;
+
+		void worker();
+		void build(PipelineId id);
+		VkDescriptorSetLayout create_set_layout(const std::vector<VkDescriptorSetLayoutBinding>& bindings, const std::vector<VkDescriptorBindingFlags>& flags);
+		VkPipeline compile(const PipelineState& state, VkShaderModule vertShaderModule, VkShaderModule fragShaderModule, const std::vector<ReflectedInput>& inputs, VkPipelineLayout layout, VkRenderPass pass);
+	};
+
+}
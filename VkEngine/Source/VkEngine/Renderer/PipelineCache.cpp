@@ -0,0 +1,157 @@
+#include "VkEngine/Renderer/PipelineCache.h"
+#include "VkEngine/Asset/Hash.h"
+#include "vk_engine/core/logger.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace vk_engine
+{
+
+	// file layout: this header, then the data returned by vkGetPipelineCacheData
+	struct PipelineCacheFileHeader
+	{
+		char magic[4]; // PLCH
+		uint32_t vendorID;
+		uint32_t deviceID;
+		uint32_t driverVersion;
+		uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+		uint64_t dataSize;
+		uint64_t dataHash;
+	};
+
+	static PipelineCacheFileHeader makeHeader(const VkPhysicalDeviceProperties& properties)
+	{
+		PipelineCacheFileHeader header{};
+		memcpy(header.magic, "PLCH", 4);
+		header.vendorID = properties.vendorID;
+		header.deviceID = properties.deviceID;
+		header.driverVersion = properties.driverVersion;
+		memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+		return header;
+	}
+
+	// the driver checks its own header too, but a rejected blob is silently dropped so check it up front
+	static bool validateData(const std::vector<char>& data, const VkPhysicalDeviceProperties& properties)
+	{
+		if (data.size() < sizeof(VkPipelineCacheHeaderVersionOne))
+			return false;
+
+		VkPipelineCacheHeaderVersionOne header;
+		memcpy(&header, data.data(), sizeof(header));
+
+		return header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+			header.vendorID == properties.vendorID &&
+			header.deviceID == properties.deviceID &&
+			memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+	}
+
+	static bool readCacheFile(const VkPhysicalDeviceProperties& properties, const char* path, std::vector<char>& data)
+	{
+		std::ifstream file(path, std::ios::binary | std::ios::in);
+
+		if (!file.is_open())
+			return false;
+
+		PipelineCacheFileHeader header;
+		file.read((char*) &header, sizeof(header));
+
+		PipelineCacheFileHeader expected = makeHeader(properties);
+		if (!file || memcmp(&header, &expected, offsetof(PipelineCacheFileHeader, dataSize)) != 0)
+		{
+			VK_LOG_WARN("pipeline cache was written for another device or driver, rebuilding it");
+			return false;
+		}
+
+		// the size comes from disk too, a truncated file mustn't make us allocate whatever it claims
+		std::streampos dataStart = file.tellg();
+		file.seekg(0, std::ios::end);
+		std::streamoff remaining = file.tellg() - dataStart;
+		file.seekg(dataStart);
+
+		if (!file || remaining < 0 || header.dataSize != (uint64_t) remaining)
+		{
+			VK_LOG_WARN("pipeline cache is damaged, rebuilding it");
+			return false;
+		}
+
+		data.resize(header.dataSize);
+		file.read(data.data(), header.dataSize);
+
+		if (!file || assets::hash64(data.data(), data.size()) != header.dataHash || !validateData(data, properties))
+		{
+			VK_LOG_WARN("pipeline cache is damaged, rebuilding it");
+			data.clear();
+			return false;
+		}
+
+		return true;
+	}
+
+	VkPipelineCache vk_pipeline_cache::load(VkDevice device, const VkPhysicalDeviceProperties& properties, const char* path)
+	{
+		std::vector<char> data;
+		bool loaded = readCacheFile(properties, path, data);
+
+		VkPipelineCacheCreateInfo cacheInfo{};
+		cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		cacheInfo.initialDataSize = data.size();
+		cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+		VkPipelineCache cache;
+		if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &cache) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create pipeline cache!");
+		}
+
+		if (loaded)
+		{
+			VK_LOG_INFO("pipeline cache loaded, " + std::to_string(data.size()) + " bytes");
+		}
+
+		return cache;
+	}
+
+	bool vk_pipeline_cache::save(VkDevice device, const VkPhysicalDeviceProperties& properties, VkPipelineCache cache, const char* path)
+	{
+		size_t size = dataSize(device, cache);
+		std::vector<char> data(size);
+		if (size == 0 || vkGetPipelineCacheData(device, cache, &size, data.data()) != VK_SUCCESS)
+			return false;
+
+		data.resize(size);
+
+		PipelineCacheFileHeader header = makeHeader(properties);
+		header.dataSize = data.size();
+		header.dataHash = assets::hash64(data.data(), data.size());
+
+		std::string tempPath = std::string(path) + ".tmp";
+		{
+			std::ofstream file(tempPath, std::ios::binary | std::ios::out | std::ios::trunc);
+			file.write((const char*) &header, sizeof(header));
+			file.write(data.data(), data.size());
+
+			if (!file)
+			{
+				VK_LOG_WARN("failed to write pipeline cache");
+				return false;
+			}
+		}
+
+		std::error_code error;
+		std::filesystem::rename(tempPath, path, error);
+
+		return !error;
+	}
+
+	size_t vk_pipeline_cache::dataSize(VkDevice device, VkPipelineCache cache)
+	{
+		size_t size = 0;
+		vkGetPipelineCacheData(device, cache, &size, nullptr);
+		return size;
+	}
+
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include "vk_engine/renderer/vk_type.h"
+
+namespace vk_engine
+{
+
+	// on-disk persistence of VkPipelineCache
+	namespace vk_pipeline_cache
+	{
+		/* create a pipeline cache seeded from path, the file is ignored when it is missing, damaged
+		* or written by a different vendor, device, driver version or pipeline cache UUID
+		*/
+		VkPipelineCache load(VkDevice device, const VkPhysicalDeviceProperties& properties, const char* path);
+
+		// write the cache data through a temporary file so a crash never leaves a half written cache
+		bool save(VkDevice device, const VkPhysicalDeviceProperties& properties, VkPipelineCache cache, const char* path);
+
+		size_t dataSize(VkDevice device, VkPipelineCache cache);
+	}
+
+}
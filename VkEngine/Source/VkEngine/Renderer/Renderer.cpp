@@ -7,12 +7,20 @@
 #include <chrono>
 #include <future>
 #include <filesystem>
+#include <algorithm>
+#include <tuple>
+#include <thread>
 
 #define VMA_IMPLEMENTATION
 #include "vk_engine/renderer/vk_renderer.h"
 #include "vk_engine/renderer/vk_info.h"
 #include "vk_engine/renderer/vk_texture.h"
+#include "vk_engine/assets/assets.h"
+#include "VkEngine/Renderer/PipelineCache.h"
+#include "VkEngine/Renderer/Transform.h"
+#include "VkEngine/Core/Parallel.h"
 #include "glm/gtc/matrix_transform.hpp"
+#include "json.hpp"
 
 #include "vk_engine/renderer/camera.h"
 #include "vk_engine/core/logger.h"
@@ -34,79 +42,159 @@ const bool enableValidationLayers = true;
 		}\
 	} while (0);
 
+using json = nlohmann::json;
+
 namespace vk_engine
 {
 
+	// a scene load in flight, only touched on the main thread, the loader jobs hold on to it until their completions ran
+	struct SceneLoad
+	{
+		std::string path;
+		std::chrono::steady_clock::time_point start;
+		NodeHandle root;
+
+		std::vector<assets::sceneNode> nodes;
+		std::vector<NodeHandle> handles;
+		std::vector<uint8_t> attached;
+		size_t nodesShown{ 0 };
+		bool finished{ false };
+
+		// one reference per entry, released by unload_scene
+		std::vector<std::string> meshPaths;
+		std::vector<AssetHandle> meshes;
+		std::vector<AssetHandle> textures; // per material source, default for untextured ones
+
+		std::vector<MaterialSource> materialSources;
+		std::vector<Material*> materials; // null falls back to defaultMaterial
+		std::vector<uint8_t> materialReady;
+		uint32_t materialsPending{ 0 };
+		Material* defaultMaterial{ nullptr };
+	};
+
 	constexpr float WIDTH = 1600.0f;
 	constexpr float HEIGHT = 900.0f;
 
-	constexpr unsigned int MAX_FRAMES_IN_FLIGHT = 2;
-
 	constexpr VkClearValue clearColor = { 0.25f, 0.25f, 0.25f, 1.0f };
 
+	constexpr const char* PIPELINE_CACHE_PATH = "pipeline_cache.bin";
+	constexpr float PIPELINE_CACHE_SAVE_INTERVAL = 30.0f; // seconds
+
+	constexpr const char* FRAME_SETTINGS_PATH = "engine.json";
+	constexpr float FRAME_SETTINGS_CHECK_INTERVAL = 2.0f; // seconds
+
 	std::shared_ptr<spdlog::logger> logger::_corelogger;
 	std::shared_ptr<spdlog::logger> logger::_clientlogger;
 
-	static std::vector<char> readfile(const std::string & filename)
+	static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
 	{
-		std::ifstream file(filename, std::ios::ate | std::ios::binary);
-
-		if (!file.is_open())
+		if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
 		{
-			throw std::runtime_error("failed to open file");
+			glfwSetWindowShouldClose(window, 1);
 		}
+	}
 
-		size_t filesize = (size_t)file.tellg();
-		std::vector<char> buffer(filesize);
-
-		file.seekg(0);
-		file.read(buffer.data(), filesize);
-
-		file.close();
-
-		return buffer;
+	static void framebuffer_size_callback(GLFWwindow* window, int width, int height)
+	{
+		static_cast<vk_renderer*>(glfwGetWindowUserPointer(window))->framebuffer_resized();
 	}
 
-	static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
+	// conservative test of a model space box against the clip volume, planes taken from the rows of mvp
+	static bool is_visible(const glm::mat4& mvp, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
 	{
-		if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
+		glm::mat4 rows = glm::transpose(mvp);
+		glm::vec4 planes[] =
 		{
-			glfwSetWindowShouldClose(window, 1);
+			rows[3] + rows[0], rows[3] - rows[0],
+			rows[3] + rows[1], rows[3] - rows[1],
+			rows[3] + rows[2], rows[3] - rows[2]
+		};
+
+		glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+		glm::vec3 extents = (boundsMax - boundsMin) * 0.5f;
+
+		for (const glm::vec4& plane : planes)
+		{
+			glm::vec3 normal = glm::vec3(plane);
+			float radius = glm::dot(extents, glm::abs(normal));
+
+			if (glm::dot(normal, center) + plane.w + radius < 0.0f)
+				return false;
 		}
+
+		return true;
 	}
 
 	// main loop involve rendering on the screen
 	void vk_renderer::mainloop() {
+		// culls every instance batch and packs the visible objects to the front of its range
 		auto indirectCommandsWorker = std::async(std::launch::async, [&]()
 		{
-			while (!glfwWindowShouldClose(_window))
+			while (true)
 			{
 				_drawSemaphore.acquire();
+				if (_stopWorkers)
+					break;
+
+				FrameData& frame = _frames[_currentFrame];
 
 				VkDrawIndirectCommand* drawCommands;
-				vmaMapMemory(_allocator, _indirectBuffer._allocation, (void**)&drawCommands);
+				vmaMapMemory(_allocator, frame._indirectBuffer._allocation, (void**)&drawCommands);
+
+				uint32_t* instances;
+				vmaMapMemory(_allocator, frame._instanceBuffer._allocation, (void**)&instances);
+
+				glm::mat4 viewproj = _camera->getProjectionMatrix((float) _swapChainExtent.width, (float) _swapChainExtent.height) * _camera->getViewMatrix();
+
+				const std::vector<glm::mat4>& transforms = _scene.transforms();
+				const std::vector<glm::vec3>& boundsMin = _scene.bounds_min();
+				const std::vector<glm::vec3>& boundsMax = _scene.bounds_max();
+				const std::vector<uint8_t>& flags = _scene.flags();
 
-				for (int i = 0; i < _renderables.size(); i++)
+				for (size_t i = 0; i < _instanceBatches.size(); i++)
 				{
-					RenderObject& obj = _renderables[i];
-					drawCommands[i].vertexCount = obj.mesh->_vertices.size();
-					drawCommands[i].instanceCount = 1;
-					drawCommands[i].firstVertex = 0;
-					drawCommands[i].firstInstance = i;
+					const InstanceBatch& batch = _instanceBatches[i];
+					const Submesh& submesh = batch.mesh->_submeshes[batch.submesh];
+
+					uint32_t visibleCount = 0;
+					for (uint32_t j = 0; j < batch.count; j++)
+					{
+						uint32_t objectIndex = _instanceObjects[batch.first + j];
+
+						if (flags[objectIndex] & OBJECT_HIDDEN)
+							continue;
+
+						if (_frustumCulling && !is_visible(viewproj * transforms[objectIndex], boundsMin[objectIndex], boundsMax[objectIndex]))
+							continue;
+
+						instances[batch.first + visibleCount] = objectIndex;
+						visibleCount++;
+					}
+
+					// a fully culled batch keeps its command so the draw batches stay valid
+					drawCommands[i].vertexCount = submesh.vertexCount;
+					drawCommands[i].instanceCount = visibleCount;
+					drawCommands[i].firstVertex = submesh.firstVertex;
+					drawCommands[i].firstInstance = batch.first;
 				}
 
-				vmaUnmapMemory(_allocator, _indirectBuffer._allocation);
+				vmaUnmapMemory(_allocator, frame._instanceBuffer._allocation);
+				vmaUnmapMemory(_allocator, frame._indirectBuffer._allocation);
+
+				_workersDone.release();
 			}
 		});
 
 		auto cpuToGpuWorker = std::async(std::launch::async, [&]()
 		{
-			while (!glfwWindowShouldClose(_window))
+			while (true)
 			{
 				_drawSemaphore.acquire();
+				if (_stopWorkers)
+					break;
 
 				_cameraParameters.view = _camera->getViewMatrix();
-				_cameraParameters.projection = _camera->getProjectionMatrix(WIDTH, HEIGHT);
+				_cameraParameters.projection = _camera->getProjectionMatrix((float) _swapChainExtent.width, (float) _swapChainExtent.height);
 				_cameraParameters.viewproj = _cameraParameters.projection * _cameraParameters.view;
 
 				char* camdata;
@@ -121,25 +209,30 @@ namespace vk_engine
 				memcpy(sceneData, &_sceneParameters, sizeof(GPUSceneData));
 				vmaUnmapMemory(_allocator, _sceneParametersBuffer._allocation);
 
-				void* objData;
-				vmaMapMemory(_allocator, _frames[_currentFrame]._objectBuffer._allocation, &objData);
-
-				GPUObjectData* objectSSBO = (GPUObjectData*)objData;
-
-				for (int i = 0; i < _renderables.size(); i++)
-				{
-					RenderObject& object = _renderables[i];
-					objectSSBO[i].modelMatrix = object.transformMatrix;
-				}
-
-				vmaUnmapMemory(_allocator, _frames[_currentFrame]._objectBuffer._allocation);
+				_workersDone.release();
 			}
 		});
 
 		while (!glfwWindowShouldClose(_window))
 		{
+			/* the frame's fence and the limiter are waited for before input is read rather than after presenting,
+			* so the frame is recorded from input as fresh as possible, drawFrame then finds the fence signaled
+			*/
+			if (_frameSettings.waitBeforeInput)
+			{
+				vkWaitForFences(_device, 1, &_frames[_currentFrame]._inFlightFences, VK_TRUE, UINT64_MAX);
+				wait_frame_deadline();
+			}
+
 			glfwPollEvents();
 
+			// a minimized window sleeps until it is restored instead of spinning
+			if (_swapChainOutOfDate && !recreate_swapchain())
+			{
+				glfwWaitEvents();
+				continue;
+			}
+
 			// handle user's input
 			float programTime = glfwGetTime();
 			float frametime = (programTime - _lastFrame) * 5.0f;
@@ -161,10 +254,45 @@ namespace vk_engine
 				_camera->updateCameraPos('d', frametime);
 
 			drawFrame();
+			collect_pipelines();
+
+			if (!_frameSettings.waitBeforeInput)
+			{
+				wait_frame_deadline();
+			}
+
+			if (programTime - _lastFrameSettingsCheck > FRAME_SETTINGS_CHECK_INTERVAL)
+			{
+				_lastFrameSettingsCheck = programTime;
+
+				FrameSettings settings;
+				if (read_frame_settings(settings))
+				{
+					apply_frame_settings(settings);
+				}
+			}
+
+			// pipelines created since the last save are kept even if the program doesn't shut down cleanly
+			if (programTime - _lastPipelineCacheSave > PIPELINE_CACHE_SAVE_INTERVAL)
+			{
+				_lastPipelineCacheSave = programTime;
+				savePipelineCache();
+			}
 		}
 
+		// wake the workers one last time so they see the stop flag
+		_stopWorkers = true;
+		_drawSemaphore.release(2);
+
 		indirectCommandsWorker.wait();
 		cpuToGpuWorker.wait();
+
+		// loads still running keep uploading, their completions are dropped
+		for (auto& worker : _loadWorkers)
+		{
+			worker.wait();
+		}
+
 		vkDeviceWaitIdle(_device);
 	}
 
@@ -172,14 +300,38 @@ namespace vk_engine
 	{
 		// auto start = std::chrono::steady_clock::now();
 		vkWaitForFences(_device, 1, &_frames[_currentFrame]._inFlightFences, VK_TRUE, UINT64_MAX);
+
+		// nothing acquired, the fence stays signaled and the frame is drawn again on the new swapchain
+		uint32_t imageIndex;
+		VkResult acquireResult = vkAcquireNextImageKHR(_device, _swapChain, UINT64_MAX, _frames[_currentFrame]._imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+		if (acquireResult == VK_ERROR_OUT_OF_DATE_KHR)
+		{
+			_swapChainOutOfDate = true;
+			return;
+		}
+
 		vkResetFences(_device, 1, &_frames[_currentFrame]._inFlightFences);
 
+		_frames[_currentFrame]._deletionQueue.flush();
+
+		// finished loads add materials and renderables, so before anything is uploaded
+		run_load_completions();
+		upload_materials();
+
+		// the workers are idle between frames, so the scene and the batches they walk can change here
+		update_transforms();
+
+		if (_instancesDirty)
+		{
+			build_instances();
+		}
+
+		reserve_objects(_scene.size(), _instanceBatches.size());
+
 		// start memcpy to gpu
 		_drawSemaphore.release();
 		_drawSemaphore.release();
 
-		uint32_t imageIndex;
-		vkAcquireNextImageKHR(_device, _swapChain, UINT64_MAX, _frames[_currentFrame]._imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
 		vkResetCommandBuffer(_frames[_currentFrame]._maincommandBuffer, VK_COMMAND_BUFFER_RESET_RELEASE_RESOURCES_BIT);
 
 		// rerecord the command buffer
@@ -215,6 +367,9 @@ namespace vk_engine
 		vkCmdSetViewport(_frames[_currentFrame]._maincommandBuffer, 0, 1, viewports);
 		vkCmdSetScissor(_frames[_currentFrame]._maincommandBuffer, 0, 1, scissors);
 
+		// copies aren't allowed inside a render pass
+		upload_objects(_frames[_currentFrame]._maincommandBuffer, _frames[_currentFrame]);
+
 		VkRenderPassBeginInfo renderPassInfo{};
 		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
 		renderPassInfo.renderPass = _renderpass;
@@ -226,7 +381,7 @@ namespace vk_engine
 
 		vkCmdBeginRenderPass(_frames[_currentFrame]._maincommandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-		draw_objects(_frames[_currentFrame]._maincommandBuffer, _renderables.data(), _renderables.size(), _frames[_currentFrame]);
+		draw_objects(_frames[_currentFrame]._maincommandBuffer, _frames[_currentFrame]);
 
 		vkCmdEndRenderPass(_frames[_currentFrame]._maincommandBuffer);
 
@@ -247,6 +402,13 @@ namespace vk_engine
 		submitInfo.signalSemaphoreCount = 1;
 		submitInfo.pSignalSemaphores = signalSemaphores;
 
+		// recording overlaps the uploads, but the gpu mustn't see the buffers before they are complete
+		_workersDone.acquire();
+		_workersDone.acquire();
+
+		// held through present too, the present queue is usually the graphics queue
+		std::lock_guard<std::mutex> queueLock(_queueMutex);
+
 		VK_CHECK(vkQueueSubmit(_graphicsQueue, 1, &submitInfo, _frames[_currentFrame]._inFlightFences));
 
 		VkPresentInfoKHR presentInfo{};
@@ -260,9 +422,14 @@ namespace vk_engine
 		presentInfo.pImageIndices = &imageIndex;
 		presentInfo.pResults = nullptr; // optional
 
-		vkQueuePresentKHR(_presentQueue, &presentInfo);
+		// a suboptimal swapchain still presented this frame, it is replaced before the next one
+		VkResult presentResult = vkQueuePresentKHR(_presentQueue, &presentInfo);
+		if (presentResult == VK_ERROR_OUT_OF_DATE_KHR || presentResult == VK_SUBOPTIMAL_KHR || acquireResult == VK_SUBOPTIMAL_KHR)
+		{
+			_swapChainOutOfDate = true;
+		}
 
-		_currentFrame = 1 - _currentFrame;
+		_currentFrame = (_currentFrame + 1) % _frameSettings.framesInFlight;
 		_frameNumber += 1;
 
 		/* auto end = std::chrono::steady_clock::now();
@@ -270,11 +437,9 @@ namespace vk_engine
 		std::cout << "frame time: " << elapsed_seconds.count() * 100 << "ms\n"; */
 	}
 
-	void vk_renderer::draw_objects(VkCommandBuffer cmd, RenderObject* first, int count, const FrameData& frame)
+	void vk_renderer::draw_objects(VkCommandBuffer cmd, const FrameData& frame)
 	{
-		std::vector<IndirectBatch> draws = compactDraw(first, count);
-
-		for (const auto& draw : draws)
+		for (const auto& draw : _drawBatches)
 		{
 			vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, draw.material->pipeline);
 
@@ -284,39 +449,47 @@ namespace vk_engine
 			//object data descriptor
 			vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, draw.material->pipelineLayout, 1, 1, &frame._objectDescriptor, 0, nullptr);
 
+			if (draw.material->setCount > 2)
+			{
+				vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, draw.material->pipelineLayout, 2, 1, &_textureDescriptor, 0, nullptr);
+			}
+
 			VkDeviceSize offset = 0;
 			vkCmdBindVertexBuffers(cmd, 0, 1, &draw.mesh->_vertexBuffer._buffer, &offset);
 
 			VkDeviceSize indirectOffset = draw.first * sizeof(VkDrawIndirectCommand);
 			uint32_t drawStride = sizeof(VkDrawIndirectCommand);
 
-			vkCmdDrawIndirect(cmd, _indirectBuffer._buffer, indirectOffset, draw.count, drawStride);
+			if (_supportsMultiDraw)
+			{
+				vkCmdDrawIndirect(cmd, frame._indirectBuffer._buffer, indirectOffset, draw.count, drawStride);
+			}
+			else
+			{
+				for (uint32_t i = 0; i < draw.count; i++)
+				{
+					vkCmdDrawIndirect(cmd, frame._indirectBuffer._buffer, indirectOffset + i * drawStride, 1, drawStride);
+				}
+			}
 		}
 	}
 
-	std::vector<IndirectBatch> vk_renderer::compactDraw(RenderObject* objs, int count)
+	std::vector<IndirectBatch> vk_renderer::compactDraw(const std::vector<InstanceBatch>& batches)
 	{
 		std::vector<IndirectBatch> draws;
 
-		IndirectBatch draw;
-		draw.mesh = objs[0].mesh;
-		draw.material = objs[0].material;
-		draw.first = 0;
-		draw.count = 1;
-
-		draws.push_back(draw);
-
-		for (int i = 1; i < count; i++)
+		for (uint32_t i = 0; i < batches.size(); i++)
 		{
-			if (objs[i].mesh == draws.back().mesh && objs[i].material == draws.back().material)
+			// textures are indexed per object, so materials sharing a pipeline share a batch
+			if (!draws.empty() && batches[i].mesh == draws.back().mesh && batches[i].material->pipelineId == draws.back().material->pipelineId)
 			{
 				draws.back().count++;
 			}
 			else
 			{
 				IndirectBatch newdraw;
-				newdraw.mesh = objs[i].mesh;
-				newdraw.material = objs[i].material;
+				newdraw.mesh = batches[i].mesh;
+				newdraw.material = batches[i].material;
 				newdraw.first = i;
 				newdraw.count = 1;
 
@@ -327,17 +500,72 @@ namespace vk_engine
 		return draws;
 	}
 
+	void vk_renderer::build_instances()
+	{
+		const std::vector<Mesh*>& meshes = _scene.meshes();
+		const std::vector<uint32_t>& submeshes = _scene.submeshes();
+		const std::vector<Material*>& materials = _scene.materials();
+
+		_instanceObjects.resize(_scene.size());
+		for (uint32_t i = 0; i < _scene.size(); i++)
+		{
+			_instanceObjects[i] = i;
+		}
+
+		// equal submeshes end up next to each other, ordered by pipeline and mesh so compactDraw can merge their commands
+		auto key = [&](uint32_t index)
+		{
+			return std::make_tuple(materials[index]->pipelineId, meshes[index], submeshes[index]);
+		};
+
+		std::stable_sort(_instanceObjects.begin(), _instanceObjects.end(), [&](uint32_t a, uint32_t b) { return key(a) < key(b); });
+
+		_instanceBatches.clear();
+		for (uint32_t i = 0; i < _instanceObjects.size(); i++)
+		{
+			uint32_t index = _instanceObjects[i];
+
+			if (!_instanceBatches.empty() && key(_instanceObjects[_instanceBatches.back().first]) == key(_instanceObjects[i]))
+			{
+				_instanceBatches.back().count++;
+				continue;
+			}
+
+			InstanceBatch batch;
+			batch.mesh = meshes[index];
+			batch.material = materials[index];
+			batch.submesh = submeshes[index];
+			batch.first = i;
+			batch.count = 1;
+
+			_instanceBatches.push_back(batch);
+		}
+
+		_drawBatches = compactDraw(_instanceBatches);
+		_instancesDirty = false;
+
+		VK_LOG_INFO(std::to_string(_scene.size()) + " objects in " + std::to_string(_instanceBatches.size()) + " instance batches, " + std::to_string(_drawBatches.size()) + " draws");
+	}
+
 	// run the engine
 	void vk_renderer::run()
 	{
 		logger::init();
+
+		// before any frame data or the swapchain exist, the defaults stay without an engine.json
+		FrameSettings settings;
+		if (read_frame_settings(settings))
+		{
+			_frameSettings = settings;
+		}
+
 		init_window();
 		VK_LOG_INFO("GLFW window initialized successfully");
 		init_input();
 		init_vulkan();
 		VK_LOG_INFO("Vulkan instance initialized successfully");
 		init_scene();
-		VK_LOG_INFO("Scene loaded successfully");
+		VK_LOG_INFO("Scene loading started");
 		VK_LOG_INFO("Start rendering");
 		mainloop();
 		cleanup();
@@ -350,14 +578,16 @@ namespace vk_engine
 			throw std::runtime_error("GLFW initialization failed!");
 
 		glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-		glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+		glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
 
 		_window = glfwCreateWindow(WIDTH, HEIGHT, "vk_renderer", NULL, NULL);
 	}
 
 	void vk_renderer::init_input()
 	{
+		glfwSetWindowUserPointer(_window, this);
 		glfwSetKeyCallback(_window, key_callback);
+		glfwSetFramebufferSizeCallback(_window, framebuffer_size_callback);
 		_camera = new Camera;
 		glfwSetInputMode(_window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 	}
@@ -381,60 +611,68 @@ namespace vk_engine
 		});
 
 		createSwapChain();
-		createDescriptors();
 		createRenderPass();
-		createTexturelessPipeline();
-		createGraphicsPipeline();
+		createPipelineCache();
+		createPipelines();
+		createDescriptors();
 		createFrameBuffers();
+
+		// replaced on resize, this destroys whichever swapchain is current at shutdown
+		_deletionQueue.push_function([this]()
+		{
+			destroy_swapchain();
+		});
+
 		createCommands();
 		createSyncObjects();
 	}
 
 	void vk_renderer::init_scene()
 	{
-		VK_LOG_INFO("Loading meshes...");
-
-		auto start = std::chrono::steady_clock::now();
-		load_meshes();
-		auto end = std::chrono::steady_clock::now();
-		std::chrono::duration<double> elapsed_seconds = end - start;
-		std::cout << "decompress time: " << elapsed_seconds.count() << "s\n";
-
-		// VK_LOG_INFO("Loading textures...");
-		// load_textures();
-
-		RenderObject interior;
-		interior.mesh = get_mesh("assets/Interior/interior.asset");
-		interior.material = get_material("texturelessMesh");
-		interior.transformMatrix = glm::scale(glm::mat4{ 1.0f }, glm::vec3(0.05f, 0.05f, 0.05f));
-
-		RenderObject exterior;
-		exterior.mesh = get_mesh("assets/Exterior/exterior.asset");
-		exterior.material = get_material("texturelessMesh");
-		exterior.transformMatrix = glm::scale(glm::mat4{ 1.0f }, glm::vec3(0.05f, 0.05f, 0.05f));
-
-		std::cout << "vertices: " << _meshes["assets/Interior/interior.asset"]._vertices.size() << std::endl;
-		std::cout << "vertices: " << _meshes["assets/Exterior/exterior.asset"]._vertices.size() << std::endl;
-
-		_renderables.push_back(interior);
-		_renderables.push_back(exterior);
+		// a scene asset describes the whole scene, the hard coded one below is kept for trees without one
+		for (const auto& dirEntry : std::filesystem::directory_iterator("assets"))
+		{
+			const std::string path = dirEntry.path().generic_string();
+			if (path.size() > 12 && path.compare(path.size() - 12, 12, ".scene.asset") == 0)
+			{
+				load_scene(path);
+				return;
+			}
+		}
 
-		/* VkSamplerCreateInfo samplerInfo = vk_info::SamplerCreateInfo(VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_REPEAT);
+		auto load = std::make_shared<SceneLoad>();
+		load->path = "assets";
+		load->defaultMaterial = get_material("texturelessMesh");
+		load->meshPaths = { "assets/Interior/interior.asset", "assets/Exterior/exterior.asset" };
 
-		VkSampler blockySampler{};
-		vkCreateSampler(_device, &samplerInfo, nullptr, &blockySampler);
+		// every material definition, meshes pick them up by name instead of deriving their own
+		for (const auto& dirEntry : std::filesystem::recursive_directory_iterator("assets"))
+		{
+			const std::string path = dirEntry.path().generic_string();
+			if (path.size() > 10 && path.compare(path.size() - 10, 10, ".mat.asset") == 0)
+			{
+				load->materialSources.emplace_back();
+				if (!read_material(path, load->materialSources.back()))
+				{
+					load->materialSources.pop_back();
+				}
+			}
+		}
 
-		_deletionQueue.push_function([=]() {
-			vkDestroySampler(_device, blockySampler, nullptr);
-		});
+		glm::mat4 scale = glm::scale(glm::mat4{ 1.0f }, glm::vec3(0.05f, 0.05f, 0.05f));
 
-		VkDescriptorSetAllocateInfo allocInfo = vk_info::DescriptorSetAllocateInfo(_descriptorPool, _textureSetLayout);
-		vkAllocateDescriptorSets(_device, &allocInfo, &San_Miguel.material->textureSet);
+		load->nodes.resize(3);
+		for (uint32_t i = 0; i < 3; i++)
+		{
+			const glm::mat4& local = i == 0 ? scale : glm::mat4{ 1.0f };
+			memcpy(load->nodes[i].transform, &local, sizeof(local));
 
-		VkDescriptorImageInfo imageBufferInfo = vk_info::DescriptorImageInfo(blockySampler, _textures["San_Miguel"].imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-		VkWriteDescriptorSet texture1 = vk_info::WriteDescriptorSetImage(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, San_Miguel.material->textureSet, &imageBufferInfo, 0);
+			load->nodes[i].parent = i == 0 ? assets::SCENE_NONE : 0;
+			load->nodes[i].mesh = i == 0 ? assets::SCENE_NONE : i - 1;
+			load->nodes[i].material = assets::SCENE_NONE;
+		}
 
-		vkUpdateDescriptorSets(_device, 1, &texture1, 0, nullptr); */
+		start_scene_load(load);
 	}
 
 	void Renderer::Init()
@@ -547,16 +785,59 @@ namespace vk_engine
 			queueCreateInfos.push_back(queueCreateInfo);
 		}
 
+		VkPhysicalDeviceDescriptorIndexingFeatures supportedIndexing{};
+		supportedIndexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+
+		VkPhysicalDeviceFeatures2 supported{};
+		supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		supported.pNext = &supportedIndexing;
+		vkGetPhysicalDeviceFeatures2(_physicalDevice, &supported);
+
+		const VkPhysicalDeviceFeatures& supportedFeatures = supported.features;
+
 		VkPhysicalDeviceFeatures deviceFeatures{};
 
-		VkDeviceCreateInfo deviceCreateInfo = vk_info::DeviceCreateInfo(queueCreateInfos, deviceFeatures, deviceExtensions);
+		// BC textures are uploaded as is when supported, otherwise transcoded to RGBA8 on load
+		deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+		_supportsBC = supportedFeatures.textureCompressionBC == VK_TRUE;
+
+		// every draw reads its object through firstInstance, batches go out as one multi draw when possible
+		if (!supportedFeatures.drawIndirectFirstInstance)
+		{
+			throw std::runtime_error("drawIndirectFirstInstance is not supported!");
+		}
+		deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+		deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+		_supportsMultiDraw = supportedFeatures.multiDrawIndirect == VK_TRUE;
+
+		// the bindless texture array
+		if (!supportedIndexing.shaderSampledImageArrayNonUniformIndexing || !supportedIndexing.descriptorBindingSampledImageUpdateAfterBind ||
+			!supportedIndexing.descriptorBindingPartiallyBound || !supportedIndexing.descriptorBindingVariableDescriptorCount || !supportedIndexing.runtimeDescriptorArray)
+		{
+			throw std::runtime_error("descriptor indexing is not supported!");
+		}
+
+		VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures{};
+		indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+		indexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+		indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+		indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+		indexingFeatures.descriptorBindingVariableDescriptorCount = VK_TRUE;
+		indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+
+		VkPhysicalDeviceDescriptorIndexingProperties indexingProperties{};
+		indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
 
-		VkPhysicalDeviceShaderDrawParametersFeatures deviceDrawParametersInfo{};
-		deviceDrawParametersInfo.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_DRAW_PARAMETERS_FEATURES;
-		deviceDrawParametersInfo.pNext = nullptr;
-		deviceDrawParametersInfo.shaderDrawParameters = VK_TRUE;
+		VkPhysicalDeviceProperties2 properties{};
+		properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		properties.pNext = &indexingProperties;
+		vkGetPhysicalDeviceProperties2(_physicalDevice, &properties);
 
-		deviceCreateInfo.pNext = &deviceDrawParametersInfo;
+		_maxTextures = std::min({ MAX_BINDLESS_TEXTURES, indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers, indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages, indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages });
+
+		VkDeviceCreateInfo deviceCreateInfo = vk_info::DeviceCreateInfo(queueCreateInfos, deviceFeatures, deviceExtensions);
+
+		deviceCreateInfo.pNext = &indexingFeatures;
 
 		VK_CHECK(vkCreateDevice(_physicalDevice, &deviceCreateInfo, nullptr, &_device));
 
@@ -589,12 +870,10 @@ namespace vk_engine
 
 		VkSwapchainCreateInfoKHR createInfo = vk_info::SwapChainCreateInfo(_surface, image_count, swapChainSupport, surfaceFormat, presentMode, extent, _indices);
 
-		VK_CHECK(vkCreateSwapchainKHR(_device, &createInfo, nullptr, &_swapChain));
+		// on recreation the old swapchain is handed over, the driver can reuse its resources
+		createInfo.oldSwapchain = _swapChain;
 
-		_deletionQueue.push_function([=]()
-		{
-			vkDestroySwapchainKHR(_device, _swapChain, nullptr);
-		});
+		VK_CHECK(vkCreateSwapchainKHR(_device, &createInfo, nullptr, &_swapChain));
 
 		vkGetSwapchainImagesKHR(_device, _swapChain, &image_count, nullptr);
 		_swapChainImages.resize(image_count);
@@ -607,9 +886,6 @@ namespace vk_engine
 		{
 			VkImageViewCreateInfo createInfo = vk_info::ImageViewCreateInfo(_swapChainImages[i], _swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT);
 			VK_CHECK(vkCreateImageView(_device, &createInfo, nullptr, &_swapChainImageViews[i]));
-			_deletionQueue.push_function([=](){
-				vkDestroyImageView(_device, _swapChainImageViews[i], nullptr);
-			});
 		}
 
 		VkExtent3D depthImageExtent =
@@ -633,57 +909,188 @@ namespace vk_engine
 		// allocate and create the image
 		vmaCreateImage(_allocator, &dimg_info, &dimg_allocInfo, &_depthImage._image, &_depthImage._allocation, nullptr);
 
-		_deletionQueue.push_function([=]()
-		{
-			vmaDestroyImage(_allocator, _depthImage._image, _depthImage._allocation);
-		});
-
 		// build an image-view for the depth image to use for rendering
 		VkImageViewCreateInfo dview_info = vk_info::ImageViewCreateInfo(_depthImage._image, _depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
 
 		VK_CHECK(vkCreateImageView(_device, &dview_info, nullptr, &_depthImageView));
+	}
 
-		_deletionQueue.push_function([=]()
+	bool vk_renderer::recreate_swapchain()
+	{
+		// a minimized window has no extent, the swapchain stays out of date until it is restored
+		int width, height;
+		glfwGetFramebufferSize(_window, &width, &height);
+		if (width == 0 || height == 0)
+		{
+			return false;
+		}
+
+		VkSwapchainKHR oldSwapChain = _swapChain;
+		std::vector<VkImageView> oldImageViews = _swapChainImageViews;
+		std::vector<VkFramebuffer> oldFrameBuffers = _swapChainFrameBuffers;
+		AllocatedImage oldDepthImage = _depthImage;
+		VkImageView oldDepthImageView = _depthImageView;
+
+		createSwapChain();
+		createFrameBuffers();
+
+		// frames in flight may still render into the old images, so they are retired instead of waiting for the device
+		for (VkFramebuffer frameBuffer : oldFrameBuffers)
+		{
+			retire([this, frameBuffer]()
+			{
+				vkDestroyFramebuffer(_device, frameBuffer, nullptr);
+			});
+		}
+
+		for (VkImageView imageView : oldImageViews)
+		{
+			retire([this, imageView]()
+			{
+				vkDestroyImageView(_device, imageView, nullptr);
+			});
+		}
+
+		retire([this, oldDepthImage, oldDepthImageView]()
+		{
+			vkDestroyImageView(_device, oldDepthImageView, nullptr);
+			vmaDestroyImage(_allocator, oldDepthImage._image, oldDepthImage._allocation);
+		});
+
+		retire([this, oldSwapChain]()
 		{
-			vkDestroyImageView(_device, _depthImageView, nullptr);
+			vkDestroySwapchainKHR(_device, oldSwapChain, nullptr);
 		});
+
+		_swapChainOutOfDate = false;
+
+		VK_LOG_INFO("swapchain recreated at " + std::to_string(_swapChainExtent.width) + "x" + std::to_string(_swapChainExtent.height));
+		return true;
 	}
 
-	void vk_renderer::createDescriptors()
+	void vk_renderer::destroy_swapchain()
 	{
-		// create indirect buffer
-		_indirectBuffer = create_buffer(FRAME_OVERLAP * sizeof(VkDrawIndirectCommand), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+		for (VkFramebuffer frameBuffer : _swapChainFrameBuffers)
+		{
+			vkDestroyFramebuffer(_device, frameBuffer, nullptr);
+		}
 
-		_deletionQueue.push_function([=]()
+		for (VkImageView imageView : _swapChainImageViews)
 		{
-			vmaDestroyBuffer(_allocator, _indirectBuffer._buffer, _indirectBuffer._allocation);
-		});
+			vkDestroyImageView(_device, imageView, nullptr);
+		}
 
-		// create a descriptor pool that will hold 10 uniform buffers
-		std::vector<VkDescriptorPoolSize> sizes =
+		vkDestroyImageView(_device, _depthImageView, nullptr);
+		vmaDestroyImage(_allocator, _depthImage._image, _depthImage._allocation);
+
+		vkDestroySwapchainKHR(_device, _swapChain, nullptr);
+	}
+
+	bool vk_renderer::read_frame_settings(FrameSettings& settings)
+	{
+		std::error_code error;
+		auto writeTime = std::filesystem::last_write_time(FRAME_SETTINGS_PATH, error);
+		if (error || writeTime == _frameSettingsTime)
 		{
-			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 4 },
-			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4 },
-			{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4}
-		};
+			return false;
+		}
+
+		_frameSettingsTime = writeTime;
+
+		// keys left out keep their current value
+		settings = _frameSettings;
+
+		try
+		{
+			std::ifstream file(FRAME_SETTINGS_PATH);
+			json config = json::parse(file);
+
+			int framesInFlight = config.value("framesInFlight", (int) settings.framesInFlight);
+			settings.framesInFlight = (uint32_t) std::clamp(framesInFlight, 1, (int) MAX_FRAMES_IN_FLIGHT);
+
+			std::string presentMode = config.value("presentMode", std::string());
+			if (presentMode == "fifo")
+				settings.presentMode = VK_PRESENT_MODE_FIFO_KHR;
+			else if (presentMode == "mailbox")
+				settings.presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+			else if (presentMode == "immediate")
+				settings.presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+			else if (!presentMode.empty())
+				VK_LOG_WARN(std::string(FRAME_SETTINGS_PATH) + ": unknown present mode " + presentMode);
+
+			settings.maxFps = std::max(config.value("maxFps", settings.maxFps), 0.0f);
+			settings.waitBeforeInput = config.value("waitBeforeInput", settings.waitBeforeInput);
+		}
+		catch (const std::exception& e)
+		{
+			VK_LOG_WARN(std::string("ignoring ") + FRAME_SETTINGS_PATH + ": " + e.what());
+			return false;
+		}
+
+		return true;
+	}
+
+	void vk_renderer::apply_frame_settings(const FrameSettings& settings)
+	{
+		if (settings.presentMode != _frameSettings.presentMode)
+		{
+			_swapChainOutOfDate = true;
+		}
+
+		/* retire queues onto the last submitted frame and drawFrame steps through the frames modulo the count,
+		* both only hold while the count is unchanged, so every frame is finished and flushed before it changes
+		*/
+		if (settings.framesInFlight != _frameSettings.framesInFlight)
+		{
+			for (auto& frame : _frames)
+			{
+				vkWaitForFences(_device, 1, &frame._inFlightFences, VK_TRUE, UINT64_MAX);
+				frame._deletionQueue.flush();
+			}
+
+			_currentFrame = 0;
+		}
+
+		// the limiter starts over from the next frame
+		_nextFrameDeadline = {};
+
+		_frameSettings = settings;
+
+		VK_LOG_INFO(std::to_string(_frameSettings.framesInFlight) + " frames in flight, " + (_frameSettings.maxFps > 0.0f ? std::to_string((int) _frameSettings.maxFps) + " fps limit" : std::string("no fps limit")) + (_frameSettings.waitBeforeInput ? ", waiting before input" : ""));
+	}
+
+	void vk_renderer::wait_frame_deadline()
+	{
+		if (_frameSettings.maxFps <= 0.0f)
+		{
+			return;
+		}
+
+		auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / _frameSettings.maxFps));
+		auto now = std::chrono::steady_clock::now();
 
-		VkDescriptorPoolCreateInfo poolInfo{};
-		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-		poolInfo.pNext = nullptr;
+		// deadlines advance by whole intervals so oversleeping doesn't drift the rate, a missed one restarts from now
+		_nextFrameDeadline += interval;
+		if (_nextFrameDeadline <= now)
+		{
+			_nextFrameDeadline = now;
+			return;
+		}
 
-		poolInfo.flags = 0;
-		poolInfo.maxSets = 10;
-		poolInfo.poolSizeCount = (uint32_t)sizes.size();
-		poolInfo.pPoolSizes = sizes.data();
+		std::this_thread::sleep_until(_nextFrameDeadline);
+	}
 
-		VK_CHECK(vkCreateDescriptorPool(_device, &poolInfo, nullptr, &_descriptorPool));
+	void vk_renderer::createDescriptors()
+	{
+		// pools are added on demand, so the set count only affects how often that happens
+		_descriptorAllocator.init(_device);
 
 		_deletionQueue.push_function([&]()
 		{
-			vkDestroyDescriptorPool(_device, _descriptorPool, nullptr);
+			_descriptorAllocator.cleanup();
 		});
 
-		size_t sceneParamBufferSize = FRAME_OVERLAP * pad_uniform_buffer_size(sizeof(GPUSceneData));
+		size_t sceneParamBufferSize = MAX_FRAMES_IN_FLIGHT * pad_uniform_buffer_size(sizeof(GPUSceneData));
 		_sceneParametersBuffer = create_buffer(sceneParamBufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
 
 		_deletionQueue.push_function([=]()
@@ -691,7 +1098,7 @@ namespace vk_engine
 			vmaDestroyBuffer(_allocator, _sceneParametersBuffer._buffer, _sceneParametersBuffer._allocation);
 		});
 
-		size_t cameraParamBufferSize = FRAME_OVERLAP * pad_uniform_buffer_size(sizeof(GPUCameraData));
+		size_t cameraParamBufferSize = MAX_FRAMES_IN_FLIGHT * pad_uniform_buffer_size(sizeof(GPUCameraData));
 		_cameraParametersBuffer = create_buffer(cameraParamBufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
 
 		_deletionQueue.push_function([=]()
@@ -699,37 +1106,17 @@ namespace vk_engine
 			vmaDestroyBuffer(_allocator, _cameraParametersBuffer._buffer, _cameraParametersBuffer._allocation);
 		});
 
-		// information about the binding
-		VkDescriptorSetLayoutBinding camBind = vk_info::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT, 0);
-		VkDescriptorSetLayoutBinding sceneBind = vk_info::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_FRAGMENT_BIT, 1);
-
-		VkDescriptorSetLayoutBinding bindings[] = { camBind, sceneBind };
+		_materialBuffer = create_buffer(sizeof(GPUMaterialData) * MAX_MATERIALS, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
 
-		VkDescriptorSetLayoutCreateInfo set1Info{};
-		set1Info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-		set1Info.pNext = nullptr;
-
-		set1Info.bindingCount = 2;
-		set1Info.flags = 0;
-		set1Info.pBindings = bindings;
-
-		VK_CHECK(vkCreateDescriptorSetLayout(_device, &set1Info, nullptr, &_globalSetLayout));
-
-		_deletionQueue.push_function([&]()
+		_deletionQueue.push_function([=]()
 		{
-			vkDestroyDescriptorSetLayout(_device, _globalSetLayout, nullptr);
+			vmaDestroyBuffer(_allocator, _materialBuffer._buffer, _materialBuffer._allocation);
 		});
 
-		// allocate one descriptor set for each frame
-		VkDescriptorSetAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-		allocInfo.pNext = nullptr;
-
-		allocInfo.descriptorPool = _descriptorPool;
-		allocInfo.descriptorSetCount = 1;
-		allocInfo.pSetLayouts = &_globalSetLayout;
+		// the base materials were created with the pipelines, before the buffer existed
+		upload_materials();
 
-		vkAllocateDescriptorSets(_device, &allocInfo, &_globalDescriptor);
+		_globalDescriptor = _descriptorAllocator.allocate(_globalSetLayout);
 
 		// information about the buffer we want to point at in the descriptor
 		VkDescriptorBufferInfo cambinfo{};
@@ -745,70 +1132,59 @@ namespace vk_engine
 		VkWriteDescriptorSet camwrite = vk_info::WriteDescriptorSetBuffer(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, _globalDescriptor, &cambinfo, 0);
 		VkWriteDescriptorSet scenewrite = vk_info::WriteDescriptorSetBuffer(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, _globalDescriptor, &scenebinfo, 1);
 
-		VkDescriptorSetLayoutBinding objBind = vk_info::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0);
+		VkDescriptorBufferInfo materialbinfo{};
+		materialbinfo.buffer = _materialBuffer._buffer;
+		materialbinfo.offset = 0;
+		materialbinfo.range = sizeof(GPUMaterialData) * MAX_MATERIALS;
 
-		VkDescriptorSetLayoutCreateInfo set2Info{};
-		set2Info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-		set2Info.pNext = nullptr;
+		VkWriteDescriptorSet materialwrite = vk_info::WriteDescriptorSetBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _globalDescriptor, &materialbinfo, 2);
 
-		set2Info.bindingCount = 1;
-		set2Info.flags = 0;
-		set2Info.pBindings = &objBind;
+		VkWriteDescriptorSet setwrites[] = { camwrite, scenewrite, materialwrite };
+		vkUpdateDescriptorSets(_device, 3, setwrites, 0, nullptr);
 
-		VK_CHECK(vkCreateDescriptorSetLayout(_device, &set2Info, nullptr, &_objectSetLayout));
+		// the object buffers are replaced when they grow, this destroys whichever are current at shutdown
+		create_object_buffers();
 
-		_deletionQueue.push_function([&]()
+		_deletionQueue.push_function([=]()
 		{
-			vkDestroyDescriptorSetLayout(_device, _objectSetLayout, nullptr);
+			destroy_object_buffers();
 		});
 
-		for (int i = 0; i < FRAME_OVERLAP; i++)
-		{
-			const int MAX_OBJECTS = 32767;
-			_frames[i]._objectBuffer = create_buffer(sizeof(GPUObjectData) * MAX_OBJECTS, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+		// update after bind sets need a pool created for them
+		VkDescriptorPoolSize bindlessSize{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, _maxTextures };
 
-			_deletionQueue.push_function([=]()
-			{
-				vmaDestroyBuffer(_allocator, _frames[i]._objectBuffer._buffer, _frames[i]._objectBuffer._allocation);
-			});
+		VkDescriptorPoolCreateInfo bindlessPoolInfo{};
+		bindlessPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		bindlessPoolInfo.pNext = nullptr;
 
-			// allocate one descriptor set for each frame
-			VkDescriptorSetAllocateInfo allocInfo{};
-			allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-			allocInfo.pNext = nullptr;
+		bindlessPoolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+		bindlessPoolInfo.maxSets = 1;
+		bindlessPoolInfo.poolSizeCount = 1;
+		bindlessPoolInfo.pPoolSizes = &bindlessSize;
 
-			allocInfo.descriptorPool = _descriptorPool;
-			allocInfo.descriptorSetCount = 1;
-			allocInfo.pSetLayouts = &_objectSetLayout;
+		VK_CHECK(vkCreateDescriptorPool(_device, &bindlessPoolInfo, nullptr, &_bindlessPool));
 
-			vkAllocateDescriptorSets(_device, &allocInfo, &_frames[i]._objectDescriptor);
+		_deletionQueue.push_function([&]()
+		{
+			vkDestroyDescriptorPool(_device, _bindlessPool, nullptr);
+		});
 
-			VkDescriptorBufferInfo objbinfo{};
-			objbinfo.buffer = _frames[i]._objectBuffer._buffer;
-			objbinfo.offset = 0;
-			objbinfo.range = sizeof(GPUObjectData) * MAX_OBJECTS;
+		VkDescriptorSetVariableDescriptorCountAllocateInfo countInfo{};
+		countInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO;
+		countInfo.descriptorSetCount = 1;
+		countInfo.pDescriptorCounts = &_maxTextures;
 
-			VkWriteDescriptorSet objwrite = vk_info::WriteDescriptorSetBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _frames[i]._objectDescriptor, &objbinfo, 0);
+		VkDescriptorSetAllocateInfo textureAllocInfo = vk_info::DescriptorSetAllocateInfo(_bindlessPool, _textureSetLayout);
+		textureAllocInfo.pNext = &countInfo;
 
-			VkWriteDescriptorSet setwrites[] = { camwrite, scenewrite, objwrite };
-			vkUpdateDescriptorSets(_device, 3, setwrites, 0, nullptr);
-		}
-
-		VkDescriptorSetLayoutBinding texBind = vk_info::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0);
-
-		VkDescriptorSetLayoutCreateInfo set3Info{};
-		set3Info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-		set3Info.pNext = nullptr;
-
-		set3Info.bindingCount = 1;
-		set3Info.flags = 0;
-		set3Info.pBindings = &texBind;
+		VK_CHECK(vkAllocateDescriptorSets(_device, &textureAllocInfo, &_textureDescriptor));
 
-		VK_CHECK(vkCreateDescriptorSetLayout(_device, &set3Info, nullptr, &_textureSetLayout));
+		VkSamplerCreateInfo samplerInfo = vk_info::SamplerCreateInfo(VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_REPEAT);
+		VK_CHECK(vkCreateSampler(_device, &samplerInfo, nullptr, &_defaultSampler));
 
-		_deletionQueue.push_function([&]()
+		_deletionQueue.push_function([=]()
 		{
-			vkDestroyDescriptorSetLayout(_device, _textureSetLayout, nullptr);
+			vkDestroySampler(_device, _defaultSampler, nullptr);
 		});
 	}
 
@@ -867,214 +1243,78 @@ namespace vk_engine
 		});
 	}
 
-	VkPipeline vk_engine::PipelineBuilder::build_pipeline(VkDevice device, VkRenderPass pass)
-	{
-		VkPipelineColorBlendStateCreateInfo colorBlending = vk_info::ColorBlendStateCreateInfo(_colorBlendAttachment);
-
-		VkGraphicsPipelineCreateInfo pipelineInfo{};
-		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-		pipelineInfo.stageCount = 2;
-		pipelineInfo.pStages = _shaderStages;
-		pipelineInfo.pVertexInputState = &_vertexInputInfo;
-		pipelineInfo.pInputAssemblyState = &_inputAssembly;
-		pipelineInfo.pViewportState = &_viewportState;
-		pipelineInfo.pRasterizationState = &_rasterizer;
-		pipelineInfo.pMultisampleState = &_multisampling;
-		pipelineInfo.pDepthStencilState = &_depthStencil;
-		pipelineInfo.pColorBlendState = &colorBlending;
-		pipelineInfo.pDynamicState = &_dynamicState;
-		pipelineInfo.layout = _pipelineLayout;
-		pipelineInfo.renderPass = pass;
-		pipelineInfo.subpass = 0;
-		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // optional
-		pipelineInfo.basePipelineIndex = -1; // optional
-
-		VkPipeline pipeline{};
-		VK_CHECK(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline));
-
-		return pipeline;
-	}
-
-	void vk_renderer::createGraphicsPipeline()
+	void vk_renderer::createPipelineCache()
 	{
-		PipelineBuilder graphic_pipeline_info{};
-
-		auto vertShaderCode = readfile("shaders/vert.spv");
-		auto fragShaderCode = readfile("shaders/frag.spv");
-		VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-		VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
-
-		VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
-		vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-		vertShaderStageInfo.module = vertShaderModule;
-		vertShaderStageInfo.pName = "main";
-
-		VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
-		fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-		fragShaderStageInfo.module = fragShaderModule;
-		fragShaderStageInfo.pName = "main";
-		VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
-
-		VkPipelineLayoutCreateInfo pipelineLayoutInfo = vk_info::PipelineLayoutCreateInfo();
-
-		pipelineLayoutInfo.pPushConstantRanges = nullptr;
-		pipelineLayoutInfo.pushConstantRangeCount = 0;
-
-		// hook the global set layout
-		VkDescriptorSetLayout setLayouts[] = { _globalSetLayout, _objectSetLayout, _textureSetLayout };
-		pipelineLayoutInfo.setLayoutCount = 3;
-		pipelineLayoutInfo.pSetLayouts = setLayouts;
-
-		VK_CHECK(vkCreatePipelineLayout(_device, &pipelineLayoutInfo, nullptr, &_pipelineLayout));
+		_pipelineCache = vk_pipeline_cache::load(_device, _deviceProperties, PIPELINE_CACHE_PATH);
+		_pipelineCacheSavedSize = vk_pipeline_cache::dataSize(_device, _pipelineCache);
 
 		_deletionQueue.push_function([=]()
 		{
-			vkDestroyPipelineLayout(_device, _pipelineLayout, nullptr);
+			vkDestroyPipelineCache(_device, _pipelineCache, nullptr);
 		});
+	}
 
-		VertexInputDescription description = Vertex::get_vertex_description();
-		VkPipelineVertexInputStateCreateInfo vertexInputInfo = vk_info::VertexInputStateCreateInfo(description.bindings, description.attributes);
-		VkPipelineInputAssemblyStateCreateInfo inputAssembly = vk_info::InputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
-		VkDynamicState DynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
-	
-		VkPipelineDynamicStateCreateInfo dynamicState{};
-		dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-		dynamicState.pNext =  nullptr;
-		dynamicState.dynamicStateCount = 2;
-		dynamicState.pDynamicStates = DynamicStates;
-
-		VkPipelineViewportStateCreateInfo viewportState{};
-		viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-		viewportState.viewportCount = 1;
-		viewportState.pViewports = nullptr;
-		viewportState.scissorCount = 1;
-		viewportState.pScissors = nullptr;
-
-		VkPipelineRasterizationStateCreateInfo rasterizer = vk_info::RasterizationStateCreateInfo(VK_POLYGON_MODE_FILL);
-		VkPipelineMultisampleStateCreateInfo multisampling = vk_info::MultisampleStateCreateInfo();
-		VkPipelineColorBlendAttachmentState colorBlendAttachment = vk_info::ColorBlendAttachmentState();
-		VkPipelineDepthStencilStateCreateInfo DepthStencilState = vk_info::PipelineDepthStencilStateCreateInfo(true, true, VK_COMPARE_OP_LESS);
-
-		graphic_pipeline_info._shaderStages = shaderStages;
-		graphic_pipeline_info._vertexInputInfo = vertexInputInfo;
-		graphic_pipeline_info._inputAssembly = inputAssembly;
-		graphic_pipeline_info._viewportState = viewportState;
-		graphic_pipeline_info._rasterizer = rasterizer;
-		graphic_pipeline_info._multisampling = multisampling;
-		graphic_pipeline_info._depthStencil = DepthStencilState;
-		graphic_pipeline_info._colorBlendAttachment = colorBlendAttachment;
-		graphic_pipeline_info._dynamicState = dynamicState;
-		graphic_pipeline_info._pipelineLayout = _pipelineLayout;
-		_graphicsPipeline = graphic_pipeline_info.build_pipeline(_device, _renderpass);
-
-		create_material(_graphicsPipeline, _pipelineLayout, "defaultMesh");
+	void vk_renderer::savePipelineCache()
+	{
+		// nothing was compiled since the last save
+		size_t size = vk_pipeline_cache::dataSize(_device, _pipelineCache);
+		if (size == _pipelineCacheSavedSize)
+			return;
 
-		_deletionQueue.push_function([=]()
+		if (vk_pipeline_cache::save(_device, _deviceProperties, _pipelineCache, PIPELINE_CACHE_PATH))
 		{
-			vkDestroyPipeline(_device, _graphicsPipeline, nullptr);
-		});
-
-		vkDestroyShaderModule(_device, vertShaderModule, nullptr);
-		vkDestroyShaderModule(_device, fragShaderModule, nullptr);
+			_pipelineCacheSavedSize = size;
+		}
 	}
 
-	void vk_renderer::createTexturelessPipeline() {
-		PipelineBuilder graphic_pipeline_info{};
-
-		auto vertShaderCode = readfile("shaders/textureless_mesh.spv");
-		auto fragShaderCode = readfile("shaders/textureless.spv");
-		VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-		VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
-
-		VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
-		vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-		vertShaderStageInfo.module = vertShaderModule;
-		vertShaderStageInfo.pName = "main";
-
-		VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
-		fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-		fragShaderStageInfo.module = fragShaderModule;
-		fragShaderStageInfo.pName = "main";
-		VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
-
-		VkPipelineLayoutCreateInfo pipelineLayoutInfo = vk_info::PipelineLayoutCreateInfo();
-
-		pipelineLayoutInfo.pPushConstantRanges = nullptr;
-		pipelineLayoutInfo.pushConstantRangeCount = 0;
-
-		// hook the global set layout
-		VkDescriptorSetLayout setLayouts[] = { _globalSetLayout, _objectSetLayout };
-		pipelineLayoutInfo.setLayoutCount = 2;
-		pipelineLayoutInfo.pSetLayouts = setLayouts;
-
-		VK_CHECK(vkCreatePipelineLayout(_device, &pipelineLayoutInfo, nullptr, &_texturelesspipelineLayout));
+	void vk_renderer::createPipelines()
+	{
+		_pipelines.init(_device, _pipelineCache);
 
 		_deletionQueue.push_function([=]()
 		{
-			vkDestroyPipelineLayout(_device, _texturelesspipelineLayout, nullptr);
+			_pipelines.cleanup();
 		});
 
-		VertexInputDescription description = Vertex::get_vertex_description();
-		VkPipelineVertexInputStateCreateInfo vertexInputInfo = vk_info::VertexInputStateCreateInfo(description.bindings, description.attributes);
-		VkPipelineInputAssemblyStateCreateInfo inputAssembly = vk_info::InputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
-		VkDynamicState DynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
-
-		VkPipelineDynamicStateCreateInfo dynamicState{};
-		dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-		dynamicState.pNext = nullptr;
-		dynamicState.dynamicStateCount = 2;
-		dynamicState.pDynamicStates = DynamicStates;
-
-		VkPipelineViewportStateCreateInfo viewportState{};
-		viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-		viewportState.viewportCount = 1;
-		viewportState.pViewports = nullptr;
-		viewportState.scissorCount = 1;
-		viewportState.pScissors = nullptr;
-
-		VkPipelineRasterizationStateCreateInfo rasterizer = vk_info::RasterizationStateCreateInfo(VK_POLYGON_MODE_FILL);
-		VkPipelineMultisampleStateCreateInfo multisampling = vk_info::MultisampleStateCreateInfo();
-		VkPipelineColorBlendAttachmentState colorBlendAttachment = vk_info::ColorBlendAttachmentState();
-		VkPipelineDepthStencilStateCreateInfo DepthStencilState = vk_info::PipelineDepthStencilStateCreateInfo(true, true, VK_COMPARE_OP_LESS);
-
-		graphic_pipeline_info._shaderStages = shaderStages;
-		graphic_pipeline_info._vertexInputInfo = vertexInputInfo;
-		graphic_pipeline_info._inputAssembly = inputAssembly;
-		graphic_pipeline_info._viewportState = viewportState;
-		graphic_pipeline_info._rasterizer = rasterizer;
-		graphic_pipeline_info._multisampling = multisampling;
-		graphic_pipeline_info._depthStencil = DepthStencilState;
-		graphic_pipeline_info._colorBlendAttachment = colorBlendAttachment;
-		graphic_pipeline_info._dynamicState = dynamicState;
-		graphic_pipeline_info._pipelineLayout = _texturelesspipelineLayout;
-		_texturelesPipeline = graphic_pipeline_info.build_pipeline(_device, _renderpass);
-
-		create_material(_texturelesPipeline, _texturelesspipelineLayout, "texturelessMesh");
-
-		_deletionQueue.push_function([=]()
+		// camera and scene data live in one buffer per frame and are bound with dynamic offsets,
+		// the texture array is sized for the device and only the slots that were written may be read
+		std::vector<DescriptorOverride> overrides =
 		{
-			vkDestroyPipeline(_device, _texturelesPipeline, nullptr);
-		});
+			{ 0, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC },
+			{ 0, 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC },
+			{ 2, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, _maxTextures, VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT }
+		};
 
-		vkDestroyShaderModule(_device, vertShaderModule, nullptr);
-		vkDestroyShaderModule(_device, fragShaderModule, nullptr);
+		PipelineState textureless;
+		textureless.vertexShader = _pipelines.register_shader("shaders/TexturelessMesh.vert.spv");
+		textureless.fragmentShader = _pipelines.register_shader("shaders/Textureless.frag.spv");
+		textureless.layout = _pipelines.register_layout(textureless.vertexShader, textureless.fragmentShader, overrides);
+		textureless.renderPass = _pipelines.register_render_pass(_renderpass);
+
+		PipelineState textured = textureless;
+		textured.vertexShader = _pipelines.register_shader("shaders/TriMesh.vert.spv");
+		textured.fragmentShader = _pipelines.register_shader("shaders/AmbientTexture.frag.spv");
+		textured.layout = _pipelines.register_layout(textured.vertexShader, textured.fragmentShader, overrides);
+
+		// the textured layout uses every set, descriptor sets allocated from it are compatible with both pipelines
+		_globalSetLayout = _pipelines.set_layout(textured.layout, 0);
+		_objectSetLayout = _pipelines.set_layout(textured.layout, 1);
+		_textureSetLayout = _pipelines.set_layout(textured.layout, 2);
+
+		// compilation starts in the background, get_material blocks only on the pipelines the scene asks for
+		create_material("texturelessMesh", textureless);
+		create_material("defaultMesh", textured);
 	}
 
-	VkShaderModule vk_renderer::createShaderModule(const std::vector<char>& code)
+	void vk_renderer::collect_pipelines()
 	{
-		VkShaderModuleCreateInfo createInfo{};
-		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-		createInfo.codeSize = code.size();
-		createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
-	
-		VkShaderModule shaderModule;
-		VK_CHECK(vkCreateShaderModule(_device, &createInfo, nullptr, &shaderModule));
-
-		return shaderModule;
+		for (auto& [name, material] : _materials)
+		{
+			if (material.pipeline == VK_NULL_HANDLE)
+			{
+				material.pipeline = _pipelines.try_pipeline(material.pipelineId);
+			}
+		}
 	}
 
 	void vk_renderer::createFrameBuffers() {
@@ -1092,10 +1332,6 @@ namespace vk_engine
 			framebufferInfo.attachmentCount = 2;
 
 			VK_CHECK(vkCreateFramebuffer(_device, &framebufferInfo, nullptr, &_swapChainFrameBuffers[i]));
-			_deletionQueue.push_function([=]()
-			{
-				vkDestroyFramebuffer(_device, _swapChainFrameBuffers[i], nullptr);
-			});
 		}
 	}
 
@@ -1110,9 +1346,10 @@ namespace vk_engine
 		{
 			VK_CHECK(vkCreateCommandPool(_device, &poolInfo, nullptr, &frame._commandPool));
 
+			VkCommandPool commandPool = frame._commandPool;
 			_deletionQueue.push_function([=]()
 			{
-				vkDestroyCommandPool(_device, frame._commandPool, nullptr);
+				vkDestroyCommandPool(_device, commandPool, nullptr);
 			});
 
 			VkCommandBufferAllocateInfo allocInfo{};
@@ -1146,7 +1383,7 @@ namespace vk_engine
 			VK_CHECK(vkCreateSemaphore(_device, &semaphoreInfo, nullptr, &frame._imageAvailableSemaphore));
 			VK_CHECK(vkCreateSemaphore(_device, &semaphoreInfo, nullptr, &frame._renderFinishedSemaphore));
 			VK_CHECK(vkCreateFence(_device, &fenceInfo, nullptr, &frame._inFlightFences));
-			_deletionQueue.push_function([=]()
+			_deletionQueue.push_function([this, &frame]()
 			{
 				vkDestroySemaphore(_device, frame._imageAvailableSemaphore, nullptr);
 				vkDestroySemaphore(_device, frame._renderFinishedSemaphore, nullptr);
@@ -1167,6 +1404,17 @@ namespace vk_engine
 	// cleanup memory after terminate the program
 	void vk_renderer::cleanup()
 	{
+		savePipelineCache();
+
+		// the device is idle, whatever is still loaded or retired goes before the allocator
+		for (auto& frame : _frames)
+		{
+			frame._deletionQueue.flush();
+		}
+
+		_meshes.clear([this](Mesh& mesh) { destroy_mesh(mesh); });
+		_textures.clear([this](Texture& texture) { destroy_texture(texture); });
+
 		_deletionQueue.flush();
 
 		glfwDestroyWindow(_window);
@@ -1206,131 +1454,881 @@ namespace vk_engine
 
 	Mesh* vk_renderer::get_mesh(const std::string& name)
 	{
-		if (_meshes.find(name) != _meshes.end())
+		return _meshes.get(_meshes.find(name));
+	}
+
+	Material* vk_renderer::get_material(const std::string& name)
+	{
+		auto it = _materials.find(name);
+		if (it == _materials.end())
 		{
-			return &_meshes[name];
+			return nullptr;
 		}
-		else
+
+		// the pipeline may still be compiling, wait for this one only
+		Material& material = it->second;
+		if (material.pipeline == VK_NULL_HANDLE)
+		{
+			material.pipeline = _pipelines.pipeline(material.pipelineId);
+		}
+
+		return material.pipeline != VK_NULL_HANDLE ? &material : nullptr;
+	}
+
+	Material* vk_renderer::create_material(const std::string& name, const PipelineState& state)
+	{
+		Material mat;
+		mat.pipelineId = _pipelines.request(state);
+		mat.pipeline = _pipelines.try_pipeline(mat.pipelineId);
+		mat.pipelineLayout = _pipelines.layout(mat.pipelineId);
+		mat.setCount = _pipelines.set_count(mat.pipelineId);
+
+		return create_material(name, mat, GPUMaterialData{});
+	}
+
+	Material* vk_renderer::create_material(const std::string& name, const Material& base, const GPUMaterialData& parameters)
+	{
+		// renderables point at the existing entry and its slot in the material buffer, so it is never replaced
+		auto it = _materials.find(name);
+		if (it != _materials.end())
+		{
+			VK_LOG_WARN("material " + name + " already exists, keeping the first definition");
+			return &it->second;
+		}
+
+		if (_materialParameters.size() >= MAX_MATERIALS)
+		{
+			throw std::runtime_error("material buffer is full!");
+		}
+
+		Material mat = base;
+		mat.materialIndex = (uint32_t) _materialParameters.size();
+		_materialParameters.push_back(parameters);
+
+		return &_materials.emplace(name, mat).first->second;
+	}
+
+	Material* vk_renderer::load_material(const std::string& path)
+	{
+		std::string name = std::filesystem::path(path).filename().string();
+		name = name.substr(0, name.find('.'));
+
+		auto it = _materials.find(name);
+		if (it != _materials.end())
+		{
+			return &it->second;
+		}
+
+		MaterialSource source;
+		if (!read_material(path, source))
 		{
 			return nullptr;
 		}
+
+		bool inserted = false;
+		if (!source.texturePath.empty())
+		{
+			_textures.acquire(source.texturePath, &inserted);
+		}
+
+		if (inserted)
+		{
+			AssetHandle handle = _textures.find(source.texturePath);
+
+			Texture texture;
+			if (load_texture(source.texturePath, texture))
+			{
+				_textures.publish(handle, std::move(texture));
+			}
+			else
+			{
+				_textures.fail(handle);
+			}
+		}
+
+		return create_material(source);
 	}
 
-	Material* vk_renderer::get_material(const std::string& name)
+	bool vk_renderer::read_material(const std::string& path, MaterialSource& source)
 	{
-		if (_materials.find(name) != _materials.end())
+		assets::assetFile file;
+		if (!assets::loadAssetFile(path.c_str(), file))
 		{
-			return &_materials[name];
+			VK_LOG_ERROR("failed to load material " + path);
+			return false;
 		}
-		else
+
+		assets::materialInfo info = assets::readMaterialInfo(&file);
+
+		source.name = std::filesystem::path(path).filename().string();
+		source.name = source.name.substr(0, source.name.find('.'));
+		source.baseMaterial = info.baseMaterial;
+		source.baseColor = glm::vec4(info.baseColor[0], info.baseColor[1], info.baseColor[2], info.baseColor[3]);
+
+		if (!info.baseColorTexture.empty())
+		{
+			source.texturePath = (std::filesystem::path(path).parent_path() / info.baseColorTexture).generic_string();
+		}
+
+		return true;
+	}
+
+	bool vk_renderer::load_texture(const std::string& path, Texture& texture)
+	{
+		VkFormat format;
+		if (!vk_util::load_image_from_file(this, path.c_str(), texture.Image, format))
 		{
+			return false;
+		}
+
+		VkImageViewCreateInfo imageInfo = vk_info::ImageViewCreateInfo(texture.Image._image, format, VK_IMAGE_ASPECT_COLOR_BIT);
+		VK_CHECK(vkCreateImageView(_device, &imageInfo, nullptr, &texture.imageView));
+
+		return true;
+	}
+
+	Material* vk_renderer::create_material(const MaterialSource& source)
+	{
+		auto it = _materials.find(source.name);
+		if (it != _materials.end())
+		{
+			return &it->second;
+		}
+
+		Material* base = get_material(source.baseMaterial);
+		if (!base)
+		{
+			VK_LOG_ERROR(source.name + " uses unknown base material " + source.baseMaterial);
 			return nullptr;
 		}
+
+		GPUMaterialData parameters;
+		parameters.baseColor = source.baseColor;
+
+		AssetHandle textureHandle;
+		if (!source.texturePath.empty())
+		{
+			textureHandle = _textures.find(source.texturePath);
+			Texture* texture = _textures.get(textureHandle);
+
+			// a missing texture leaves the material untextured rather than failing the whole material
+			if (texture)
+			{
+				if (texture->index == NO_TEXTURE)
+				{
+					texture->index = register_texture(texture->imageView, _defaultSampler);
+				}
+
+				parameters.textureIndex = texture->index;
+			}
+			else
+			{
+				VK_LOG_WARN(source.name + ": failed to load " + source.texturePath);
+				textureHandle = {};
+			}
+		}
+
+		Material* material = create_material(source.name, *base, parameters);
+		material->texture = textureHandle;
+		return material;
 	}
 
-	Material* vk_renderer::create_material(VkPipeline pipeline, VkPipelineLayout layout, const std::string& name)
+	void vk_renderer::upload_materials()
 	{
-		Material mat;
-		mat.pipeline = pipeline;
-		mat.pipelineLayout = layout;
-		_materials[name] = mat;
-		return &_materials[name];
+		// a rewritten entry can be anywhere, copy them all
+		if (_materialsRewritten)
+		{
+			_uploadedMaterials = 0;
+			_materialsRewritten = false;
+		}
+
+		if (_uploadedMaterials == _materialParameters.size())
+		{
+			return;
+		}
+
+		char* data;
+		vmaMapMemory(_allocator, _materialBuffer._allocation, (void**)&data);
+		memcpy(data + _uploadedMaterials * sizeof(GPUMaterialData), _materialParameters.data() + _uploadedMaterials, (_materialParameters.size() - _uploadedMaterials) * sizeof(GPUMaterialData));
+		vmaUnmapMemory(_allocator, _materialBuffer._allocation);
+
+		_uploadedMaterials = _materialParameters.size();
 	}
 
-	void vk_renderer::load_meshes()
+	uint32_t vk_renderer::register_texture(VkImageView imageView, VkSampler sampler)
 	{
-		auto worker1 = std::async(std::launch::async, [&]()
+		uint32_t index;
+		if (!_freeTextureSlots.empty())
 		{
-			Mesh::load_from_obj("assets/Interior/interior.asset", this);
-		});
+			index = _freeTextureSlots.back();
+			_freeTextureSlots.pop_back();
+		}
+		else if (_textureCount == _maxTextures)
+		{
+			throw std::runtime_error("bindless texture array is full!");
+		}
+		else
+		{
+			index = _textureCount++;
+		}
 
-		auto worker2 = std::async(std::launch::async, [&]()
+		VkDescriptorImageInfo imageInfo = vk_info::DescriptorImageInfo(sampler, imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		VkWriteDescriptorSet write = vk_info::WriteDescriptorSetImage(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, _textureDescriptor, &imageInfo, 0);
+		write.dstArrayElement = index;
+
+		// the slot isn't used by any submitted frame, new or retired long enough, which update after bind allows to write while the set is bound
+		vkUpdateDescriptorSets(_device, 1, &write, 0, nullptr);
+
+		return index;
+	}
+
+	std::vector<ObjectHandle> vk_renderer::add_renderable(Mesh* mesh, Material* fallback, const glm::mat4& transform)
+	{
+		std::vector<ObjectHandle> objects;
+		objects.reserve(mesh->_submeshes.size());
+
+		for (uint32_t i = 0; i < mesh->_submeshes.size(); i++)
 		{
-			Mesh::load_from_obj("assets/Exterior/exterior.asset", this);
-		});
+			const Submesh& submesh = mesh->_submeshes[i];
+
+			// materials the mesh names but nobody defined are derived from the fallback with the source colour
+			Material* material = nullptr;
+			if (submesh.material < mesh->_materialNames.size())
+			{
+				const std::string& name = mesh->_materialNames[submesh.material];
+				material = get_material(name);
+
+				if (!material && fallback && !name.empty())
+				{
+					GPUMaterialData parameters;
+					parameters.baseColor = glm::vec4(mesh->_materialColors[submesh.material], 1.0f);
+					material = create_material(name, *fallback, parameters);
+				}
+			}
+
+			objects.push_back(_scene.create(mesh, i, material ? material : fallback, transform));
+		}
+
+		_instancesDirty = true;
+		return objects;
 	}
 
-	void vk_renderer::upload_mesh(Mesh& mesh)
+	void vk_renderer::remove_renderable(ObjectHandle object)
 	{
-		const size_t bufferSize = mesh._vertices.size() * sizeof(Vertex);
+		if (!_scene.valid(object))
+			return;
 
-		// allocate Staging Buffer
-		VkBufferCreateInfo stagingBufferInfo{};
-		stagingBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-		// total size in bytes
-		stagingBufferInfo.size = bufferSize;
-		stagingBufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		// the last object moves into the freed index, the batches are rebuilt and the moved object uploaded again
+		_scene.destroy(object);
+		_instancesDirty = true;
+	}
 
-		// let vma know this buffer is gonna written by cpu and read by gpu
-		VmaAllocationCreateInfo allocationInfo{};
-		allocationInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+	void vk_renderer::set_transform(ObjectHandle object, const glm::mat4& transform)
+	{
+		_scene.set_transform(object, transform);
+	}
 
-		AllocatedBuffer stagingBuffer;
+	NodeHandle vk_renderer::create_node(const glm::mat4& local, NodeHandle parent)
+	{
+		NodeHandle node = _hierarchy.create(local, parent);
+
+		if (_nodeObjects.size() <= node.slot)
+		{
+			_nodeObjects.resize(node.slot + 1);
+		}
 
-		VK_CHECK(vmaCreateBuffer(_allocator, &stagingBufferInfo, &allocationInfo, &stagingBuffer._buffer, &stagingBuffer._allocation, nullptr));
+		return node;
+	}
 
-		// copy vertex data
-		void* data;
-		vmaMapMemory(_allocator, stagingBuffer._allocation, &data);
+	void vk_renderer::remove_node(NodeHandle node)
+	{
+		for (NodeHandle removed : _hierarchy.destroy(node))
+		{
+			for (ObjectHandle object : _nodeObjects[removed.slot])
+			{
+				remove_renderable(object);
+			}
+			_nodeObjects[removed.slot].clear();
+		}
+	}
 
-		memcpy(data, mesh._vertices.data(), bufferSize);
+	void vk_renderer::set_local_transform(NodeHandle node, const glm::mat4& local)
+	{
+		_hierarchy.set_local(node, local);
+	}
 
-		vmaUnmapMemory(_allocator, stagingBuffer._allocation);
+	std::vector<ObjectHandle> vk_renderer::add_renderable(Mesh* mesh, Material* fallback, NodeHandle node)
+	{
+		// a node created since the last update has no world matrix yet, update_transforms corrects the objects then
+		std::vector<ObjectHandle> objects = add_renderable(mesh, fallback, _hierarchy.world(node));
 
-		// allocate Vertex Buffer
-		VkBufferCreateInfo vertexBufferInfo{};
-		vertexBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-		// total size in bytes
-		vertexBufferInfo.size = bufferSize;
-		vertexBufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		std::vector<ObjectHandle>& attached = _nodeObjects[node.slot];
+		attached.insert(attached.end(), objects.begin(), objects.end());
 
-		// let vma know this buffer is gonna written by cpu and read by gpu
-		allocationInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+		return objects;
+	}
 
-		VK_CHECK(vmaCreateBuffer(_allocator, &vertexBufferInfo, &allocationInfo, &mesh._vertexBuffer._buffer, &mesh._vertexBuffer._allocation, nullptr));
+	void vk_renderer::update_transforms()
+	{
+		_changedNodes.clear();
+		_hierarchy.update(_changedNodes);
 
-		_deletionQueue.push_function([=]()
+		for (NodeHandle node : _changedNodes)
 		{
-			vmaDestroyBuffer(_allocator, mesh._vertexBuffer._buffer, mesh._vertexBuffer._allocation);
-		});
+			const glm::mat4& world = _hierarchy.world(node);
+
+			for (ObjectHandle object : _nodeObjects[node.slot])
+			{
+				if (_scene.valid(object))
+				{
+					_scene.set_transform(object, world);
+				}
+			}
+		}
+	}
 
-		immediate_submit([=](VkCommandBuffer cmd)
+	void vk_renderer::create_object_buffers()
+	{
+		// only written by copies from the staging buffers
+		_objectBuffer = create_buffer(sizeof(GPUObjectData) * _objectStats.objectCapacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+		_objectMaterialBuffer = create_buffer(sizeof(uint32_t) * _objectStats.objectCapacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+
+		VkDescriptorBufferInfo objbinfo{};
+		objbinfo.buffer = _objectBuffer._buffer;
+		objbinfo.offset = 0;
+		objbinfo.range = sizeof(GPUObjectData) * _objectStats.objectCapacity;
+
+		VkDescriptorBufferInfo objmatbinfo{};
+		objmatbinfo.buffer = _objectMaterialBuffer._buffer;
+		objmatbinfo.offset = 0;
+		objmatbinfo.range = sizeof(uint32_t) * _objectStats.objectCapacity;
+
+		for (auto& frame : _frames)
 		{
-			VkBufferCopy copy;
-			copy.srcOffset = 0;
-			copy.dstOffset = 0;
-			copy.size = bufferSize;
-			vkCmdCopyBuffer(cmd, stagingBuffer._buffer, mesh._vertexBuffer._buffer, 1, &copy);
-		});
+			// a fresh set each time, frames in flight keep reading the old buffers through theirs
+			frame._objectDescriptor = _descriptorAllocator.allocate(_objectSetLayout);
+
+			frame._instanceBuffer = create_buffer(sizeof(uint32_t) * _objectStats.objectCapacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+
+			// transforms first, then the material indices, each as many as the frame's dirty objects
+			frame._objectStaging = create_buffer((sizeof(GPUObjectData) + sizeof(uint32_t)) * _objectStats.objectCapacity, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+
+			frame._indirectBuffer = create_buffer(sizeof(VkDrawIndirectCommand) * _objectStats.commandCapacity, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+
+			VkDescriptorBufferInfo instancebinfo{};
+			instancebinfo.buffer = frame._instanceBuffer._buffer;
+			instancebinfo.offset = 0;
+			instancebinfo.range = sizeof(uint32_t) * _objectStats.objectCapacity;
+
+			VkWriteDescriptorSet setwrites[] =
+			{
+				vk_info::WriteDescriptorSetBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame._objectDescriptor, &objbinfo, 0),
+				vk_info::WriteDescriptorSetBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame._objectDescriptor, &objmatbinfo, 1),
+				vk_info::WriteDescriptorSetBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame._objectDescriptor, &instancebinfo, 2)
+			};
+			vkUpdateDescriptorSets(_device, 3, setwrites, 0, nullptr);
+		}
+	}
+
+	void vk_renderer::destroy_object_buffers()
+	{
+		vmaDestroyBuffer(_allocator, _objectBuffer._buffer, _objectBuffer._allocation);
+		vmaDestroyBuffer(_allocator, _objectMaterialBuffer._buffer, _objectMaterialBuffer._allocation);
+
+		for (auto& frame : _frames)
+		{
+			vmaDestroyBuffer(_allocator, frame._instanceBuffer._buffer, frame._instanceBuffer._allocation);
+			vmaDestroyBuffer(_allocator, frame._objectStaging._buffer, frame._objectStaging._allocation);
+			vmaDestroyBuffer(_allocator, frame._indirectBuffer._buffer, frame._indirectBuffer._allocation);
+		}
+	}
+
+	void vk_renderer::reserve_objects(uint32_t objects, uint32_t commands)
+	{
+		_objectStats.objectHighWater = std::max(_objectStats.objectHighWater, objects);
+		_objectStats.commandHighWater = std::max(_objectStats.commandHighWater, commands);
+
+		if (objects <= _objectStats.objectCapacity && commands <= _objectStats.commandCapacity)
+			return;
+
+		while (_objectStats.objectCapacity < objects)
+		{
+			_objectStats.objectCapacity *= 2;
+		}
+
+		while (_objectStats.commandCapacity < commands)
+		{
+			_objectStats.commandCapacity *= 2;
+		}
+
+		/* frames in flight still draw from the old buffers, so they are retired instead of idling the device,
+		* the new buffers start empty and every object is uploaded again from _scene with this frame
+		*/
+		auto retireBuffer = [this](AllocatedBuffer buffer)
+		{
+			retire([this, buffer]()
+			{
+				vmaDestroyBuffer(_allocator, buffer._buffer, buffer._allocation);
+			});
+		};
+
+		retireBuffer(_objectBuffer);
+		retireBuffer(_objectMaterialBuffer);
+
+		for (auto& frame : _frames)
+		{
+			retireBuffer(frame._instanceBuffer);
+			retireBuffer(frame._objectStaging);
+			retireBuffer(frame._indirectBuffer);
+		}
+
+		create_object_buffers();
+
+		_scene.mark_all_dirty();
+
+		_objectStats.growCount++;
+
+		VK_LOG_INFO("object buffers grown to " + std::to_string(_objectStats.objectCapacity) + " objects, " + std::to_string(_objectStats.commandCapacity) + " draw commands");
+	}
+
+	void vk_renderer::upload_objects(VkCommandBuffer cmd, FrameData& frame)
+	{
+		if (_scene.dirty().empty())
+			return;
+
+		// sorted so neighbouring objects merge into one copy region
+		std::vector<uint32_t> dirty = _scene.dirty();
+		std::sort(dirty.begin(), dirty.end());
+		_scene.clear_dirty();
+
+		const std::vector<glm::mat4>& sceneTransforms = _scene.transforms();
+		const std::vector<Material*>& sceneMaterials = _scene.materials();
+
+		const VkDeviceSize materialOffset = sizeof(GPUObjectData) * _objectStats.objectCapacity;
+
+		char* staging;
+		vmaMapMemory(_allocator, frame._objectStaging._allocation, (void**)&staging);
+
+		GPUObjectData* transforms = (GPUObjectData*)staging;
+		uint32_t* materials = (uint32_t*)(staging + materialOffset);
+
+		std::vector<VkBufferCopy> transformCopies;
+		std::vector<VkBufferCopy> materialCopies;
+
+		for (uint32_t i = 0; i < dirty.size(); i++)
+		{
+			uint32_t object = dirty[i];
+
+			pack_affine(sceneTransforms[object], transforms[i].rows);
+			materials[i] = sceneMaterials[object]->materialIndex;
+
+			if (i > 0 && dirty[i - 1] + 1 == object)
+			{
+				transformCopies.back().size += sizeof(GPUObjectData);
+				materialCopies.back().size += sizeof(uint32_t);
+				continue;
+			}
+
+			transformCopies.push_back({ i * sizeof(GPUObjectData), object * sizeof(GPUObjectData), sizeof(GPUObjectData) });
+			materialCopies.push_back({ materialOffset + i * sizeof(uint32_t), object * sizeof(uint32_t), sizeof(uint32_t) });
+		}
+
+		vmaUnmapMemory(_allocator, frame._objectStaging._allocation);
+
+		// the other frame may still be reading the objects, let its vertex shaders finish before overwriting them
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+		vkCmdCopyBuffer(cmd, frame._objectStaging._buffer, _objectBuffer._buffer, transformCopies.size(), transformCopies.data());
+		vkCmdCopyBuffer(cmd, frame._objectStaging._buffer, _objectMaterialBuffer._buffer, materialCopies.size(), materialCopies.data());
+
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+
+	NodeHandle vk_renderer::load_scene(const std::string& path)
+	{
+		assets::assetFile file;
+		if (!assets::loadAssetFile(path.c_str(), file))
+		{
+			throw std::runtime_error("failed to load scene " + path + "!");
+		}
+
+		assets::sceneInfo info = assets::readSceneInfo(&file);
+
+		auto load = std::make_shared<SceneLoad>();
+		load->path = path;
+
+		load->nodes.resize(info.nodeCount);
+		if (!assets::unpackScene(&info, file.binaryBlob.data(), file.binaryBlob.size(), load->nodes.data()))
+		{
+			throw std::runtime_error("failed to unpack scene " + path + "!");
+		}
+
+		// references are relative to the scene asset
+		const std::filesystem::path directory = std::filesystem::path(path).parent_path();
+
+		for (const std::string& mesh : info.meshes)
+		{
+			load->meshPaths.push_back((directory / mesh).generic_string());
+		}
+
+		// material assets are small, only their textures are worth a worker
+		for (const std::string& material : info.materials)
+		{
+			load->materialSources.emplace_back();
+			read_material((directory / material).generic_string(), load->materialSources.back());
+		}
 
-		vmaDestroyBuffer(_allocator, stagingBuffer._buffer, stagingBuffer._allocation);
+		load->defaultMaterial = get_material(info.defaultMaterial);
+		if (!load->defaultMaterial)
+		{
+			VK_LOG_WARN(path + " uses unknown default material " + info.defaultMaterial);
+			load->defaultMaterial = get_material("texturelessMesh");
+		}
+
+		return start_scene_load(load);
 	}
 
-	void vk_renderer::load_textures()
+	NodeHandle vk_renderer::start_scene_load(std::shared_ptr<SceneLoad> load)
 	{
-		for (const auto& dirEntry : std::filesystem::recursive_directory_iterator("assets/San_Miguel/textures"))
+		load->start = std::chrono::steady_clock::now();
+
+		// parents always come first, so every parent handle exists by the time its children are created
+		load->root = create_node(glm::mat4{ 1.0f });
+		load->handles.resize(load->nodes.size());
+
+		for (size_t i = 0; i < load->nodes.size(); i++)
+		{
+			const assets::sceneNode& node = load->nodes[i];
+
+			glm::mat4 local;
+			memcpy(&local, node.transform, sizeof(local));
+
+			load->handles[i] = create_node(local, node.parent == assets::SCENE_NONE ? load->root : load->handles[node.parent]);
+		}
+
+		load->attached.assign(load->nodes.size(), 0);
+		_loadProgress.nodeCount += (uint32_t) load->nodes.size();
+
+		// every job runs on a loader worker, publishes into the registry and reports back through complete_on_main
+		std::vector<std::function<void()>> jobs;
+
+		// assets another scene loaded or is loading are shared, only new entries get a job
+		for (const std::string& path : load->meshPaths)
 		{
-			auto worker = std::async(std::launch::async, [&]()
+			bool inserted;
+			AssetHandle handle = _meshes.acquire(path, &inserted);
+			load->meshes.push_back(handle);
+
+			if (!inserted)
+				continue;
+
+			_loadProgress.meshCount++;
+
+			jobs.push_back([this, handle, path]()
 			{
-				Texture texture;
-				if (vk_util::load_image_from_file(this, dirEntry.path().string().c_str(), texture.Image))
+				Mesh mesh;
+				bool loaded = false;
+
+				try
 				{
-					VkImageViewCreateInfo imageInfo = vk_info::ImageViewCreateInfo(texture.Image._image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT);
-					VK_CHECK(vkCreateImageView(_device, &imageInfo, nullptr, &texture.imageView));
+					loaded = Mesh::load_from_obj(path.c_str(), this, mesh);
+				}
+				catch (const std::exception& e)
+				{
+					VK_LOG_ERROR("failed to load mesh " + path + ": " + e.what());
+				}
 
-					_textures[dirEntry.path().string()] = texture;
+				// unloaded before it arrived, nothing has drawn it yet
+				if (!loaded)
+				{
+					_meshes.fail(handle);
+				}
+				else if (!_meshes.publish(handle, std::move(mesh)))
+				{
+					destroy_mesh(mesh);
+				}
 
-					_deletionQueue.push_function([=]()
-					{
-						vkDestroyImageView(_device, texture.imageView, nullptr);
-					});
+				complete_on_main([this]()
+				{
+					_loadProgress.meshesLoaded++;
+				});
+			});
+		}
+
+		size_t meshJobs = jobs.size();
+
+		load->materials.assign(load->materialSources.size(), nullptr);
+		load->materialReady.assign(load->materialSources.size(), 0);
+
+		for (const MaterialSource& source : load->materialSources)
+		{
+			// unreadable materials have no name and fall back to the default material
+			if (source.name.empty() || source.texturePath.empty())
+			{
+				load->textures.emplace_back();
+				continue;
+			}
+
+			bool inserted;
+			AssetHandle handle = _textures.acquire(source.texturePath, &inserted);
+			load->textures.push_back(handle);
+
+			if (!inserted)
+				continue;
+
+			_loadProgress.textureCount++;
+
+			jobs.push_back([this, handle, texturePath = source.texturePath]()
+			{
+				Texture texture{};
+				bool loaded = false;
+
+				try
+				{
+					loaded = load_texture(texturePath, texture);
 				}
+				catch (const std::exception& e)
+				{
+					VK_LOG_ERROR("failed to load texture " + texturePath + ": " + e.what());
+				}
+
+				if (!loaded)
+				{
+					_textures.fail(handle);
+				}
+				else if (!_textures.publish(handle, std::move(texture)))
+				{
+					destroy_texture(texture);
+				}
+
+				complete_on_main([this]()
+				{
+					_loadProgress.texturesLoaded++;
+				});
 			});
-		};
+		}
+
+		load->materialsPending = (uint32_t) load->materialSources.size();
+
+		VK_LOG_INFO("loading " + load->path + ": " + std::to_string(load->nodes.size()) + " nodes, " + std::to_string(meshJobs) + " meshes and " + std::to_string(jobs.size() - meshJobs) + " textures to upload");
+
+		// nodes without a mesh, and nodes whose mesh and material were loaded before, are shown right away
+		_sceneLoads.push_back(load);
+		attach_loaded(*load);
+
+		if (!jobs.empty())
+		{
+			// decompression runs in parallel, the uploads themselves take turns on the upload context
+			_loadWorkers.push_back(std::async(std::launch::async, [jobs = std::move(jobs)]()
+			{
+				parallel_for(jobs.size(), [&](size_t i)
+				{
+					jobs[i]();
+				});
+			}));
+		}
+
+		return load->root;
+	}
+
+	void vk_renderer::attach_loaded(SceneLoad& load)
+	{
+		// a material waits for its texture, loaded or failed
+		for (size_t i = 0; i < load.materialSources.size(); i++)
+		{
+			if (load.materialReady[i])
+				continue;
+
+			if (load.textures[i].index != UINT32_MAX && _textures.state(load.textures[i]) == AssetState::LOADING)
+				continue;
+
+			if (!load.materialSources[i].name.empty())
+			{
+				load.materials[i] = create_material(load.materialSources[i]);
+			}
+
+			load.materialReady[i] = 1;
+			load.materialsPending--;
+		}
+
+		for (size_t i = 0; i < load.nodes.size(); i++)
+		{
+			if (load.attached[i])
+				continue;
+
+			const assets::sceneNode& node = load.nodes[i];
+
+			if (node.mesh != assets::SCENE_NONE)
+			{
+				if (_meshes.state(load.meshes[node.mesh]) == AssetState::LOADING)
+					continue;
+
+				// an explicit material is all the node needs, otherwise submeshes may name any material of the scene
+				if (node.material != assets::SCENE_NONE ? !load.materialReady[node.material] : load.materialsPending > 0)
+					continue;
+
+				// failed meshes and nodes removed while loading are skipped
+				Mesh* mesh = _meshes.get(load.meshes[node.mesh]);
+				if (mesh && _hierarchy.valid(load.handles[i]))
+				{
+					Material* material = node.material != assets::SCENE_NONE ? load.materials[node.material] : nullptr;
+					add_renderable(mesh, material ? material : load.defaultMaterial, load.handles[i]);
+				}
+			}
+
+			load.attached[i] = 1;
+			_loadProgress.nodesShown++;
+			load.nodesShown++;
+		}
+
+		if (load.nodesShown == load.nodes.size() && !load.finished)
+		{
+			load.finished = true;
+
+			std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - load.start;
+			VK_LOG_INFO("loaded " + load.path + " in " + std::to_string(elapsed.count()) + "s, " + std::to_string(_scene.size()) + " objects, " + std::to_string(_materials.size()) + " materials");
+		}
+	}
+
+	void vk_renderer::unload_scene(NodeHandle root)
+	{
+		auto it = std::find_if(_sceneLoads.begin(), _sceneLoads.end(), [&](const std::shared_ptr<SceneLoad>& load)
+		{
+			return load->root.slot == root.slot && load->root.generation == root.generation;
+		});
+
+		if (it == _sceneLoads.end())
+		{
+			VK_LOG_WARN("unload_scene: not the root of a loaded scene");
+			return;
+		}
+
+		std::shared_ptr<SceneLoad> load = *it;
+		_sceneLoads.erase(it);
+
+		// the objects go first, nothing drawn from the next frame on references the assets
+		remove_node(load->root);
+
+		for (AssetHandle mesh : load->meshes)
+		{
+			release_mesh(mesh);
+		}
+
+		for (AssetHandle texture : load->textures)
+		{
+			if (texture.index != UINT32_MAX)
+			{
+				release_texture(texture);
+			}
+		}
+
+		VK_LOG_INFO("unloaded " + load->path + ", " + std::to_string(_meshes.size()) + " meshes and " + std::to_string(_textures.size()) + " textures still loaded");
+	}
+
+	void vk_renderer::release_mesh(AssetHandle handle)
+	{
+		Mesh mesh;
+		if (_meshes.release(handle, mesh))
+		{
+			AllocatedBuffer vertexBuffer = mesh._vertexBuffer;
+			retire([this, vertexBuffer]()
+			{
+				vmaDestroyBuffer(_allocator, vertexBuffer._buffer, vertexBuffer._allocation);
+			});
+		}
+	}
+
+	void vk_renderer::release_texture(AssetHandle handle)
+	{
+		Texture texture;
+		if (!_textures.release(handle, texture))
+			return;
+
+		// materials are kept, they lose the texture from the next frame on
+		for (auto& [name, material] : _materials)
+		{
+			if (material.texture == handle)
+			{
+				_materialParameters[material.materialIndex].textureIndex = NO_TEXTURE;
+				material.texture = {};
+				_materialsRewritten = true;
+			}
+		}
+
+		retire([this, texture]() mutable
+		{
+			destroy_texture(texture);
+
+			if (texture.index != NO_TEXTURE)
+			{
+				_freeTextureSlots.push_back(texture.index);
+			}
+		});
+	}
+
+	void vk_renderer::destroy_mesh(Mesh& mesh)
+	{
+		vmaDestroyBuffer(_allocator, mesh._vertexBuffer._buffer, mesh._vertexBuffer._allocation);
+	}
+
+	void vk_renderer::destroy_texture(Texture& texture)
+	{
+		vkDestroyImageView(_device, texture.imageView, nullptr);
+		vmaDestroyImage(_allocator, texture.Image._image, texture.Image._allocation);
+	}
+
+	void vk_renderer::retire(SmallFunction<void()>&& destroy)
+	{
+		// _currentFrame is the frame about to be recorded, which no longer sees what is retired now
+		_frames[(_currentFrame + _frameSettings.framesInFlight - 1) % _frameSettings.framesInFlight]._deletionQueue.push_function(std::move(destroy));
+	}
+
+	void vk_renderer::complete_on_main(std::function<void()>&& func)
+	{
+		std::lock_guard<std::mutex> lock(_loadMutex);
+		_loadCompletions.push_back(std::move(func));
+	}
+
+	void vk_renderer::run_load_completions()
+	{
+		std::vector<std::function<void()>> completions;
+		{
+			std::lock_guard<std::mutex> lock(_loadMutex);
+			completions.swap(_loadCompletions);
+		}
+
+		for (auto& completion : completions)
+		{
+			completion();
+		}
+
+		// something was published, scenes waiting on it may share it with the scene that loaded it
+		if (!completions.empty())
+		{
+			for (auto& load : _sceneLoads)
+			{
+				if (!load->finished)
+				{
+					attach_loaded(*load);
+				}
+			}
+		}
+
+		// a worker is done once its last completion was queued
+		std::erase_if(_loadWorkers, [](std::future<void>& worker)
+		{
+			return worker.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+		});
 	}
 
 	void vk_renderer::immediate_submit(std::function<void(VkCommandBuffer cmd)>&& func)
 	{
+		std::lock_guard<std::mutex> lock(_uploadContext._mutex);
+
 		VkCommandBufferAllocateInfo cmdAllocInfo{};
 		cmdAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
 		cmdAllocInfo.commandPool = _uploadContext._commandPool;
@@ -1356,7 +2354,11 @@ namespace vk_engine
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &cmd;
 
-		VK_CHECK(vkQueueSubmit(_graphicsQueue, 1, &submitInfo, _uploadContext._uploadFence));
+		{
+			std::lock_guard<std::mutex> queueLock(_queueMutex);
+			VK_CHECK(vkQueueSubmit(_graphicsQueue, 1, &submitInfo, _uploadContext._uploadFence));
+		}
+
 		vkWaitForFences(_device, 1, &_uploadContext._uploadFence, VK_TRUE, 1000000000);
 		vkResetFences(_device, 1, &_uploadContext._uploadFence);
 
@@ -1405,11 +2407,17 @@ namespace vk_engine
 	{
 		for (const auto& availablePresentMode : availablePresentModes)
 		{
-			if (availablePresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR) // VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR
+			if (availablePresentMode == _frameSettings.presentMode)
 			{
 				return availablePresentMode;
 			}
 		}
+
+		// the only mode every surface supports
+		if (_frameSettings.presentMode != VK_PRESENT_MODE_FIFO_KHR)
+		{
+			VK_LOG_WARN("requested present mode unsupported, falling back to fifo");
+		}
 		return VK_PRESENT_MODE_FIFO_KHR;
 	}
 
@@ -1,46 +1,48 @@
 #pragma once
 #include "vk_engine/renderer/vk_support.h"
 #include "vk_engine/renderer/vk_mesh.h"
-#include <deque>
+#include "VkEngine/Renderer/Pipeline.h"
+#include "VkEngine/Renderer/Descriptor.h"
+#include "VkEngine/Scene/SceneStore.h"
+#include "VkEngine/Scene/TransformHierarchy.h"
+#include "VkEngine/Core/AssetRegistry.h"
+#include "VkEngine/Core/SmallFunction.h"
 #include <functional>
 #include <string>
 #include <semaphore>
+#include <atomic>
+#include <mutex>
+#include <future>
+#include <memory>
+#include <chrono>
+#include <filesystem>
 #include <glm/glm.hpp>
 
-constexpr unsigned int FRAME_OVERLAP = 2;
+constexpr unsigned int MAX_FRAMES_IN_FLIGHT = 4; // frame data is created for this many, FrameSettings picks how many are used
+constexpr unsigned int INITIAL_OBJECT_CAPACITY = 1024; // doubled whenever the scene outgrows it
+constexpr unsigned int MAX_BINDLESS_TEXTURES = 4096;
+constexpr unsigned int MAX_MATERIALS = 16384;
 
 namespace vk_engine
 {
 
-	class PipelineBuilder
-	{
-	public:
-		VkPipelineShaderStageCreateInfo* _shaderStages;
-		VkPipelineVertexInputStateCreateInfo _vertexInputInfo;
-		VkPipelineInputAssemblyStateCreateInfo _inputAssembly;
-		// VkViewport _viewport;
-		// VkRect2D _scissor;
-		VkPipelineDynamicStateCreateInfo _dynamicState;
-		VkPipelineViewportStateCreateInfo _viewportState;
-		VkPipelineRasterizationStateCreateInfo _rasterizer;
-		VkPipelineColorBlendAttachmentState _colorBlendAttachment;
-		VkPipelineMultisampleStateCreateInfo _multisampling;
-		VkPipelineLayout _pipelineLayout;
-		VkPipelineDepthStencilStateCreateInfo _depthStencil;
-		VkPipeline build_pipeline(VkDevice device, VkRenderPass pass);
-	};
-
+	// destruction callbacks run newest first, the vector keeps its capacity so steady state pushes don't allocate
 	struct DeletionQueue
 	{
-		std::deque<std::function<void()>> deletors;
+		std::vector<SmallFunction<void()>> deletors;
+		std::mutex mutex; // assets push from their loading workers
 
-		void push_function(std::function<void()>&& func)
+		template<typename F>
+		void push_function(F&& func)
 		{
-			deletors.push_back(func);
+			std::lock_guard<std::mutex> lock(mutex);
+			deletors.emplace_back(std::forward<F>(func));
 		}
 
-		void flush() {
-			for (auto it = deletors.end() - 1; it > deletors.begin(); it--)
+		void flush()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (auto it = deletors.rbegin(); it != deletors.rend(); it++)
 			{
 				(*it)(); // call function
 			}
@@ -64,9 +66,30 @@ namespace vk_engine
 		glm::vec4 sunlightColor;
 	};
 
-	struct GPUObjectData
+	// std430 array element, 48 bytes instead of a full matrix, written with pack_affine
+	struct alignas(16) GPUObjectData
+	{
+		glm::vec4 rows[3]; // model matrix rows, the constant (0, 0, 0, 1) is left out
+	};
+
+	constexpr uint32_t NO_TEXTURE = UINT32_MAX;
+
+	// one entry of the material buffer, std140 like the object buffer
+	struct GPUMaterialData
 	{
-		glm::mat4 modelMatrix;
+		glm::vec4 baseColor{ 1.0f };
+		uint32_t textureIndex{ NO_TEXTURE }; // into the bindless texture array
+		uint32_t padding[3]{};
+	};
+
+	// sizes of the object and indirect buffers, the high water marks are the most ever requested
+	struct ObjectStats
+	{
+		uint32_t objectCapacity{ INITIAL_OBJECT_CAPACITY };
+		uint32_t objectHighWater{ 0 };
+		uint32_t commandCapacity{ INITIAL_OBJECT_CAPACITY };
+		uint32_t commandHighWater{ 0 };
+		uint32_t growCount{ 0 };
 	};
 
 	struct FrameData
@@ -78,42 +101,103 @@ namespace vk_engine
 		VkSemaphore _renderFinishedSemaphore;
 		VkFence _inFlightFences;
 
-		AllocatedBuffer _objectBuffer;
+		// object index per drawn instance, the culled instances of a batch packed at its front
+		AllocatedBuffer _instanceBuffer;
 		VkDescriptorSet _objectDescriptor;
+
+		// dirty objects are staged here and copied into the device local object buffers
+		AllocatedBuffer _objectStaging;
+
+		// one command per instance batch, rewritten every frame with the visible instance count
+		AllocatedBuffer _indirectBuffer;
+
+		// resources the frame may still use, destroyed once its fence has signaled
+		DeletionQueue _deletionQueue;
+	};
+
+	/* how frames are paced, read from engine.json at startup and again whenever the file changes
+	* fewer frames in flight and waitBeforeInput trade throughput for input latency
+	*/
+	struct FrameSettings
+	{
+		uint32_t framesInFlight{ 2 }; // 1 to MAX_FRAMES_IN_FLIGHT
+		VkPresentModeKHR presentMode{ VK_PRESENT_MODE_IMMEDIATE_KHR }; // FIFO when the surface doesn't support it
+		float maxFps{ 0.0f }; // frame limiter, 0 for unlimited
+		bool waitBeforeInput{ false }; // wait for the gpu and the limiter before input is sampled rather than after presenting
 	};
 
 	struct Material
 	{
-		VkDescriptorSet textureSet{ VK_NULL_HANDLE };
+		uint32_t materialIndex{ 0 }; // slot in the material buffer, reaches the shader through the object buffer
 
-		VkPipeline pipeline;
+		PipelineId pipelineId;
+		VkPipeline pipeline{ VK_NULL_HANDLE }; // VK_NULL_HANDLE until the registry finished compiling it
 		VkPipelineLayout pipelineLayout;
-	};
+		uint32_t setCount{ 0 }; // descriptor sets the layout expects, the texture array is set 2
 
-	struct RenderObject
-	{
-		Mesh* mesh;
-		Material* material;
-		glm::mat4 transformMatrix;
+		AssetHandle texture; // the parameters fall back to NO_TEXTURE when it is unloaded
 	};
 
 	struct Texture
 	{
 		AllocatedImage Image;
 		VkImageView imageView;
+		uint32_t index{ NO_TEXTURE }; // bindless slot, registered by the first material using it
+	};
+
+	// a material asset as read from disk, turned into a Material once its texture is uploaded
+	struct MaterialSource
+	{
+		std::string name;
+		std::string baseMaterial;
+		glm::vec4 baseColor{ 1.0f };
+		std::string texturePath; // empty for untextured materials
+	};
+
+	// counts over every scene load started so far, failed meshes and textures count as loaded
+	struct LoadProgress
+	{
+		uint32_t meshCount{ 0 };
+		uint32_t meshesLoaded{ 0 };
+		uint32_t textureCount{ 0 };
+		uint32_t texturesLoaded{ 0 };
+		uint32_t nodeCount{ 0 };
+		uint32_t nodesShown{ 0 }; // nodes whose renderables were added, or that have none
+
+		bool done() const { return meshesLoaded == meshCount && texturesLoaded == textureCount; }
+
+		float fraction() const
+		{
+			uint32_t total = meshCount + textureCount;
+			return total ? (float) (meshesLoaded + texturesLoaded) / total : 1.0f;
+		}
 	};
 
+	struct SceneLoad;
+
 	struct UploadContext
 	{
 		VkFence _uploadFence;
 		VkCommandPool _commandPool;
+		std::mutex _mutex; // one submit at a time, the fence and the pool are shared
 	};
 
+	// renderables sharing a submesh and a pipeline, drawn by one indirect command with an instance each
+	struct InstanceBatch
+	{
+		Mesh* mesh;
+		Material* material;
+		uint32_t submesh;
+		uint32_t first; // into _instanceObjects and the object buffer, the command's firstInstance
+		uint32_t count;
+	};
+
+	// consecutive indirect commands binding the same mesh and pipeline
 	struct IndirectBatch
 	{
 		Mesh* mesh;
 		Material* material;
-		uint32_t first;
+		uint32_t first; // into the indirect buffer
 		uint32_t count;
 	};
 
@@ -153,39 +237,122 @@ namespace vk_engine
 		// default entry point
 		void run();
 
-		// queue for destruction of Vulkan objects
+		// called by the window, the swapchain is replaced before the next frame
+		void framebuffer_resized() { _swapChainOutOfDate = true; }
+
+		/* takes effect between frames, a new present mode recreates the swapchain and
+		* a new frame count waits for the frames in flight first
+		*/
+		void apply_frame_settings(const FrameSettings& settings);
+		const FrameSettings& frame_settings() const { return _frameSettings; }
+
+		// queue for destruction of Vulkan objects living until shutdown
 		DeletionQueue _deletionQueue;
 
-		// default array of renderable objects
-		std::vector<RenderObject> _renderables;
+		// every renderable object, one per submesh
+		SceneStore _scene;
+
+		// world matrices of the nodes are propagated into the objects attached to them before each frame
+		TransformHierarchy _hierarchy;
+		std::vector<std::vector<ObjectHandle>> _nodeObjects; // indexed by NodeHandle::slot
+		std::vector<NodeHandle> _changedNodes;
+		void update_transforms();
 
 		/* _material stores pipeline of meshes
-		* _meshes stores vertices of meshes
-		* _textures store textures of meshes
+		* _meshes and _textures are keyed by asset path and shared between scenes,
+		* every scene holds a reference to what it uses and unloading the last one destroys the asset
 		*/
 		std::unordered_map<std::string, Material> _materials;
-		std::unordered_map<std::string, Mesh> _meshes;
-		std::unordered_map<std::string, Texture> _textures;
+		AssetRegistry<Mesh> _meshes;
+		AssetRegistry<Texture> _textures;
+
+		void destroy_mesh(Mesh& mesh);
+		void destroy_texture(Texture& texture);
+		// drop a reference, the gpu resources of the last one are retired
+		void release_mesh(AssetHandle mesh);
+		void release_texture(AssetHandle texture);
 
-		void load_meshes(); // load meshes data into _meshes
-		void upload_mesh(Mesh& mesh); // upload meshes data to gpu
-		void load_textures(); // load textures into _textures
+		/* destroy something frames in flight may still use, queued on the last submitted frame,
+		* whose fence signals after every earlier frame's
+		*/
+		void retire(SmallFunction<void()>&& destroy);
+
+		/* instantiate a scene asset from VkAsset under a new root node, returned at once
+		* the nodes are created here, meshes and textures upload on workers and the renderables of a node
+		* are added between frames as soon as its mesh and material are there
+		*/
+		NodeHandle load_scene(const std::string& path);
+		// removes the scene under root, a root returned by load_scene, and releases what it loaded
+		void unload_scene(NodeHandle root);
+		const LoadProgress& load_progress() const { return _loadProgress; }
 
-		// load / store from the unordered maps
+		/* loading workers never touch the scene, they queue what has to happen on the main thread,
+		* drawFrame runs the queue between frames like every other scene change
+		*/
+		std::mutex _loadMutex;
+		std::vector<std::function<void()>> _loadCompletions;
+		std::vector<std::future<void>> _loadWorkers;
+		LoadProgress _loadProgress;
+		std::vector<std::shared_ptr<SceneLoad>> _sceneLoads; // every scene loaded and not unloaded yet
+		NodeHandle start_scene_load(std::shared_ptr<SceneLoad> load);
+		void attach_loaded(SceneLoad& load);
+		void complete_on_main(std::function<void()>&& func);
+		void run_load_completions();
+
+		// load / store from the maps, get_mesh doesn't take a reference
 		Mesh* get_mesh(const std::string& name);
 		Material* get_material(const std::string& name);
-		Material* create_material(VkPipeline pipeline, VkPipelineLayout layout, const std::string& name);
+		Material* create_material(const std::string& name, const PipelineState& state);
+		// shares the pipeline of base, only the parameters differ, a name already in use returns that material unchanged
+		Material* create_material(const std::string& name, const Material& base, const GPUMaterialData& parameters);
+		// material asset from VkAsset, brick.mat.asset becomes material brick and replaces the mesh material of that name
+		// its texture is never released
+		Material* load_material(const std::string& path);
+		// the steps of load_material, reading and load_texture are safe on any thread
+		bool read_material(const std::string& path, MaterialSource& source);
+		bool load_texture(const std::string& path, Texture& texture); // the texture still has to be published into _textures
+		Material* create_material(const MaterialSource& source); // untextured unless the texture is ready in _textures
+		// one object per submesh, submeshes whose material has no pipeline use the fallback
+		std::vector<ObjectHandle> add_renderable(Mesh* mesh, Material* fallback, const glm::mat4& transform);
+		void remove_renderable(ObjectHandle object);
+		// the only way to move a renderable after adding it, the object is uploaded again with the next frame
+		void set_transform(ObjectHandle object, const glm::mat4& transform);
+
+		/* renderables added to a node follow its world matrix, set_transform on them lasts until the node moves again
+		* removing a node removes its subtree and every renderable attached to it
+		*/
+		NodeHandle create_node(const glm::mat4& local, NodeHandle parent = {});
+		void remove_node(NodeHandle node);
+		void set_local_transform(NodeHandle node, const glm::mat4& local);
+		std::vector<ObjectHandle> add_renderable(Mesh* mesh, Material* fallback, NodeHandle node);
+
+		const ObjectStats& object_stats() const { return _objectStats; }
 
 		// draw functions
 		void drawFrame();
-		void draw_objects(VkCommandBuffer cmd, RenderObject* first, int count, const FrameData& frame);
-		std::vector<IndirectBatch> compactDraw(RenderObject* objs, int count);
+		void draw_objects(VkCommandBuffer cmd, const FrameData& frame);
+		std::vector<IndirectBatch> compactDraw(const std::vector<InstanceBatch>& batches);
 
-		AllocatedBuffer _indirectBuffer;
+		/* objects of _scene grouped into instance batches, rebuilt before a frame whenever objects were added or removed
+		* _instanceObjects lists the scene indices of each batch contiguously, culling packs the visible ones into the instance buffer
+		*/
+		std::vector<InstanceBatch> _instanceBatches;
+		std::vector<uint32_t> _instanceObjects;
+		std::vector<IndirectBatch> _drawBatches;
+		bool _instancesDirty{ true };
+		void build_instances();
+
+		// submeshes outside the view frustum get an empty indirect command
+		bool _frustumCulling{ true };
 
 		// Vulkan memory allocator
 		VmaAllocator _allocator;
 
+		// whether BC compressed textures can be sampled directly
+		bool _supportsBC{ false };
+		// whether one vkCmdDrawIndirect may issue more than one draw
+		bool _supportsMultiDraw{ false };
+
 		// create buffer for gpu
 		AllocatedBuffer create_buffer(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage);
 
@@ -193,8 +360,8 @@ namespace vk_engine
 		UploadContext _uploadContext;
 		void immediate_submit(std::function<void(VkCommandBuffer cmd)>&& func);
 
-		// frame data
-		FrameData _frames[FRAME_OVERLAP];
+		// frame data, only the first _frameSettings.framesInFlight are used
+		FrameData _frames[MAX_FRAMES_IN_FLIGHT];
 
 		size_t _currentFrame{ 0 };
 		size_t _frameNumber{ 0 };
@@ -210,16 +377,32 @@ namespace vk_engine
 
 		// gpu queue for command submission handler
 		VkQueue _graphicsQueue;
+		std::mutex _queueMutex; // loading workers submit uploads while frames are submitted
 		VkQueue _presentQueue;
 		QueueFamilyIndices _indices;
 
 		// swapchain handler
-		VkSwapchainKHR _swapChain;
+		VkSwapchainKHR _swapChain{ VK_NULL_HANDLE };
 		std::vector<VkImage> _swapChainImages;
 		VkFormat _swapChainImageFormat;
 		VkExtent2D _swapChainExtent;
 		std::vector<VkImageView> _swapChainImageViews;
 
+		/* set on resize and by out of date or suboptimal acquire / present results,
+		* the swapchain, depth image and framebuffers are then replaced between frames, the old ones retired
+		*/
+		bool _swapChainOutOfDate{ false };
+		bool recreate_swapchain(); // false while the window is minimized
+		void destroy_swapchain();
+
+		// frame pacing, engine.json is checked for changes every few seconds
+		FrameSettings _frameSettings;
+		std::filesystem::file_time_type _frameSettingsTime{};
+		float _lastFrameSettingsCheck{ 0 };
+		std::chrono::steady_clock::time_point _nextFrameDeadline{};
+		bool read_frame_settings(FrameSettings& settings); // false when engine.json is missing or unchanged
+		void wait_frame_deadline(); // sleeps out the rest of the frame under maxFps
+
 		// depth image handler
 		VkImageView _depthImageView;
 		AllocatedImage _depthImage;
@@ -228,12 +411,13 @@ namespace vk_engine
 		// renderpass handler
 		VkRenderPass _renderpass;
 
-		// pipeline handler
-		VkPipelineLayout _pipelineLayout;
-		VkPipeline _graphicsPipeline;
+		// every pipeline is owned here, materials with equal state share one
+		PipelineRegistry _pipelines;
 
-		VkPipelineLayout _texturelesspipelineLayout;
-		VkPipeline _texturelesPipeline;
+		// pipeline cache persisted between runs, saved on shutdown and whenever it grew
+		VkPipelineCache _pipelineCache{ VK_NULL_HANDLE };
+		size_t _pipelineCacheSavedSize{ 0 };
+		float _lastPipelineCacheSave{ 0 };
 
 		// framebuffer handler
 		std::vector<VkFramebuffer> _swapChainFrameBuffers;
@@ -241,8 +425,24 @@ namespace vk_engine
 		// device properties
 		VkPhysicalDeviceProperties _deviceProperties;
 
-		// semaphore for multithreaded command recording
+		/* object data lives in device local memory indexed like the _scene columns and is shared by every frame,
+		* only the objects _scene marked dirty are staged and copied at the start of a frame
+		*/
+		AllocatedBuffer _objectBuffer;
+		AllocatedBuffer _objectMaterialBuffer; // material index per object, kept apart so transforms stay 16 byte aligned
+		void upload_objects(VkCommandBuffer cmd, FrameData& frame);
+
+		// object, instance, staging and indirect buffers, all sized from _objectStats
+		ObjectStats _objectStats;
+		void create_object_buffers();
+		void destroy_object_buffers();
+		// called between frames, replaces every buffer with a larger one when one was too small, the old ones are retired
+		void reserve_objects(uint32_t objects, uint32_t commands);
+
+		// the two upload workers are started by _drawSemaphore and report back through _workersDone before submission
 		std::counting_semaphore<2> _drawSemaphore{ 0 };
+		std::counting_semaphore<2> _workersDone{ 0 };
+		std::atomic<bool> _stopWorkers{ false };
 
 		// init functions
 		void init_window();
@@ -256,9 +456,10 @@ namespace vk_engine
 		void createSwapChain();
 		void createRenderPass();
 		void createDescriptors();
-		void createGraphicsPipeline();
-		void createTexturelessPipeline();
-		VkShaderModule createShaderModule(const std::vector<char>& code);
+		void createPipelineCache();
+		void savePipelineCache();
+		void createPipelines();
+		void collect_pipelines(); // pick up pipelines finished in the background
 		void createFrameBuffers();
 		void createCommands();
 		void createSyncObjects();
@@ -276,10 +477,33 @@ namespace vk_engine
 		// descriptor sets
 		VkDescriptorSet _globalDescriptor;
 
+		// reflected from the shaders, owned by _pipelines
 		VkDescriptorSetLayout _globalSetLayout;
 		VkDescriptorSetLayout _objectSetLayout;
 		VkDescriptorSetLayout _textureSetLayout;
-		VkDescriptorPool _descriptorPool;
+
+		DescriptorAllocator _descriptorAllocator;
+
+		// one update after bind array of every texture, bound once per batch whatever the material
+		VkDescriptorPool _bindlessPool;
+		VkDescriptorSet _textureDescriptor;
+		uint32_t _textureCount{ 0 };
+		uint32_t _maxTextures{ MAX_BINDLESS_TEXTURES };
+
+		// write a texture into the array, the index stays valid until the texture is unloaded
+		uint32_t register_texture(VkImageView imageView, VkSampler sampler);
+		std::vector<uint32_t> _freeTextureSlots; // slots of unloaded textures, reused before the array grows
+		VkSampler _defaultSampler;
+
+		/* material parameters are appended on the cpu and the new entries copied before each frame,
+		* entries are only rewritten when their texture is unloaded, frames in flight reading the old index
+		* still find the texture since it is retired rather than destroyed
+		*/
+		AllocatedBuffer _materialBuffer;
+		std::vector<GPUMaterialData> _materialParameters;
+		size_t _uploadedMaterials{ 0 };
+		bool _materialsRewritten{ false };
+		void upload_materials();
 
 		// scene parameters
 		GPUSceneData _sceneParameters;
@@ -0,0 +1,418 @@
+#include "VkEngine/Renderer/ShaderReflection.h"
+#include <algorithm>
+#include <unordered_map>
+
+namespace vk_engine
+{
+
+	// the subset of the SPIR-V spec the reflection needs
+	namespace spirv
+	{
+		constexpr uint32_t MAGIC = 0x07230203;
+
+		enum Op : uint32_t
+		{
+			OpEntryPoint = 15,
+			OpTypeInt = 21,
+			OpTypeFloat = 22,
+			OpTypeVector = 23,
+			OpTypeMatrix = 24,
+			OpTypeImage = 25,
+			OpTypeSampler = 26,
+			OpTypeSampledImage = 27,
+			OpTypeArray = 28,
+			OpTypeRuntimeArray = 29,
+			OpTypeStruct = 30,
+			OpTypePointer = 32,
+			OpConstant = 43,
+			OpVariable = 59,
+			OpDecorate = 71,
+			OpMemberDecorate = 72
+		};
+
+		enum Decoration : uint32_t
+		{
+			Block = 2,
+			BufferBlock = 3,
+			ArrayStride = 6,
+			MatrixStride = 7,
+			BuiltIn = 11,
+			Location = 30,
+			Binding = 33,
+			DescriptorSet = 34,
+			Offset = 35
+		};
+
+		enum StorageClass : uint32_t
+		{
+			UniformConstant = 0,
+			Input = 1,
+			Uniform = 2,
+			PushConstant = 9,
+			StorageBuffer = 12
+		};
+
+		enum ExecutionModel : uint32_t
+		{
+			Vertex = 0,
+			Fragment = 4,
+			GLCompute = 5
+		};
+
+		enum Dim : uint32_t
+		{
+			DimBuffer = 5
+		};
+	}
+
+	struct SpirvId
+	{
+		uint32_t opcode{ 0 };
+		std::vector<uint32_t> operands; // words after the result id
+
+		// decorations
+		bool block{ false };
+		bool bufferBlock{ false };
+		bool builtIn{ false };
+		uint32_t set{ UINT32_MAX };
+		uint32_t binding{ UINT32_MAX };
+		uint32_t location{ UINT32_MAX };
+		uint32_t arrayStride{ 0 };
+		std::vector<uint32_t> memberOffsets;
+		std::vector<uint32_t> memberMatrixStrides;
+	};
+
+	static void setMember(std::vector<uint32_t>& values, uint32_t member, uint32_t value)
+	{
+		if (values.size() <= member)
+			values.resize(member + 1, 0);
+		values[member] = value;
+	}
+
+	// byte size of a type inside a uniform or push constant block
+	static uint32_t typeSize(const std::vector<SpirvId>& ids, uint32_t typeId, uint32_t matrixStride = 0)
+	{
+		const SpirvId& type = ids[typeId];
+
+		switch (type.opcode)
+		{
+		case spirv::OpTypeInt:
+		case spirv::OpTypeFloat:
+			return type.operands[0] / 8;
+		case spirv::OpTypeVector:
+			return typeSize(ids, type.operands[0]) * type.operands[1];
+		case spirv::OpTypeMatrix:
+			return (matrixStride ? matrixStride : typeSize(ids, type.operands[0])) * type.operands[1];
+		case spirv::OpTypeArray:
+		{
+			uint32_t length = ids[type.operands[1]].operands.back();
+			return (type.arrayStride ? type.arrayStride : typeSize(ids, type.operands[0])) * length;
+		}
+		case spirv::OpTypeStruct:
+		{
+			uint32_t size = 0;
+			for (uint32_t i = 0; i < type.operands.size(); i++)
+			{
+				uint32_t offset = i < type.memberOffsets.size() ? type.memberOffsets[i] : 0;
+				uint32_t stride = i < type.memberMatrixStrides.size() ? type.memberMatrixStrides[i] : 0;
+				size = std::max(size, offset + typeSize(ids, type.operands[i], stride));
+			}
+			return size;
+		}
+		default:
+			return 0;
+		}
+	}
+
+	static VkFormat inputFormat(const std::vector<SpirvId>& ids, uint32_t typeId)
+	{
+		const SpirvId& type = ids[typeId];
+
+		uint32_t components = 1;
+		const SpirvId* scalar = &type;
+		if (type.opcode == spirv::OpTypeVector)
+		{
+			components = type.operands[1];
+			scalar = &ids[type.operands[0]];
+		}
+
+		if (scalar->operands.empty() || scalar->operands[0] != 32)
+			return VK_FORMAT_UNDEFINED;
+
+		static const VkFormat floatFormats[] = { VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT };
+		static const VkFormat sintFormats[] = { VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT };
+		static const VkFormat uintFormats[] = { VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT };
+
+		if (scalar->opcode == spirv::OpTypeFloat)
+			return floatFormats[components - 1];
+		if (scalar->opcode == spirv::OpTypeInt)
+			return scalar->operands[1] ? sintFormats[components - 1] : uintFormats[components - 1];
+
+		return VK_FORMAT_UNDEFINED;
+	}
+
+	static bool descriptorType(const std::vector<SpirvId>& ids, uint32_t storageClass, uint32_t typeId, VkDescriptorType& descriptorType, uint32_t& count)
+	{
+		count = 1;
+
+		// arrays of descriptors
+		const SpirvId* type = &ids[typeId];
+		if (type->opcode == spirv::OpTypeArray)
+		{
+			count = ids[type->operands[1]].operands.back();
+			type = &ids[type->operands[0]];
+		}
+		else if (type->opcode == spirv::OpTypeRuntimeArray)
+		{
+			count = 0;
+			type = &ids[type->operands[0]];
+		}
+
+		switch (storageClass)
+		{
+		case spirv::Uniform:
+			descriptorType = type->bufferBlock ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+			return true;
+		case spirv::StorageBuffer:
+			descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			return true;
+		case spirv::UniformConstant:
+			switch (type->opcode)
+			{
+			case spirv::OpTypeSampledImage:
+				descriptorType = ids[type->operands[0]].operands[1] == spirv::DimBuffer ? VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+				return true;
+			case spirv::OpTypeImage:
+			{
+				// operands: sampled type, dim, depth, arrayed, ms, sampled (1 with sampler, 2 storage)
+				bool storage = type->operands[5] == 2;
+				if (type->operands[1] == spirv::DimBuffer)
+					descriptorType = storage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+				else
+					descriptorType = storage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+				return true;
+			}
+			case spirv::OpTypeSampler:
+				descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	bool vk_reflect::reflect(const uint32_t* code, size_t wordCount, ShaderReflection& reflection, std::string& error)
+	{
+		if (wordCount < 5 || code[0] != spirv::MAGIC)
+		{
+			error = "not a SPIR-V module";
+			return false;
+		}
+
+		uint32_t bound = code[3];
+		std::vector<SpirvId> ids(bound);
+		std::vector<uint32_t> variables;
+
+		// one pass collecting types, variables and decorations
+		for (size_t offset = 5; offset < wordCount;)
+		{
+			uint32_t opcode = code[offset] & 0xFFFF;
+			uint32_t length = code[offset] >> 16;
+
+			if (length == 0 || offset + length > wordCount)
+			{
+				error = "truncated instruction";
+				return false;
+			}
+
+			const uint32_t* words = code + offset + 1;
+
+			switch (opcode)
+			{
+			case spirv::OpEntryPoint:
+				switch (words[0])
+				{
+				case spirv::Vertex: reflection.stages |= VK_SHADER_STAGE_VERTEX_BIT; break;
+				case spirv::Fragment: reflection.stages |= VK_SHADER_STAGE_FRAGMENT_BIT; break;
+				case spirv::GLCompute: reflection.stages |= VK_SHADER_STAGE_COMPUTE_BIT; break;
+				}
+				break;
+
+			case spirv::OpTypeInt:
+			case spirv::OpTypeFloat:
+			case spirv::OpTypeVector:
+			case spirv::OpTypeMatrix:
+			case spirv::OpTypeImage:
+			case spirv::OpTypeSampler:
+			case spirv::OpTypeSampledImage:
+			case spirv::OpTypeArray:
+			case spirv::OpTypeRuntimeArray:
+			case spirv::OpTypeStruct:
+			case spirv::OpTypePointer:
+				if (words[0] < bound)
+				{
+					ids[words[0]].opcode = opcode;
+					ids[words[0]].operands.assign(words + 1, words + length - 1);
+				}
+				break;
+
+			case spirv::OpConstant:
+				// result type, result id, value
+				if (words[1] < bound)
+				{
+					ids[words[1]].opcode = opcode;
+					ids[words[1]].operands.assign(words + 2, words + length - 1);
+				}
+				break;
+
+			case spirv::OpVariable:
+				// result type, result id, storage class
+				if (words[1] < bound)
+				{
+					ids[words[1]].opcode = opcode;
+					ids[words[1]].operands = { words[0], words[2] };
+					variables.push_back(words[1]);
+				}
+				break;
+
+			case spirv::OpDecorate:
+				if (words[0] < bound)
+				{
+					SpirvId& target = ids[words[0]];
+					switch (words[1])
+					{
+					case spirv::Block: target.block = true; break;
+					case spirv::BufferBlock: target.bufferBlock = true; break;
+					case spirv::BuiltIn: target.builtIn = true; break;
+					case spirv::ArrayStride: target.arrayStride = words[2]; break;
+					case spirv::Location: target.location = words[2]; break;
+					case spirv::Binding: target.binding = words[2]; break;
+					case spirv::DescriptorSet: target.set = words[2]; break;
+					}
+				}
+				break;
+
+			case spirv::OpMemberDecorate:
+				if (words[0] < bound)
+				{
+					SpirvId& target = ids[words[0]];
+					switch (words[2])
+					{
+					case spirv::Offset: setMember(target.memberOffsets, words[1], words[3]); break;
+					case spirv::MatrixStride: setMember(target.memberMatrixStrides, words[1], words[3]); break;
+					case spirv::BuiltIn: target.builtIn = true; break;
+					}
+				}
+				break;
+			}
+
+			offset += length;
+		}
+
+		for (uint32_t id : variables)
+		{
+			const SpirvId& variable = ids[id];
+			const SpirvId& pointer = ids[variable.operands[0]];
+			uint32_t storageClass = variable.operands[1];
+			uint32_t typeId = pointer.operands[1];
+
+			if (storageClass == spirv::PushConstant)
+			{
+				VkPushConstantRange range{};
+				range.stageFlags = reflection.stages;
+				range.offset = 0;
+				range.size = typeSize(ids, typeId);
+				reflection.pushConstants.push_back(range);
+			}
+			else if (storageClass == spirv::Input)
+			{
+				if (!(reflection.stages & VK_SHADER_STAGE_VERTEX_BIT) || variable.builtIn || ids[typeId].builtIn || variable.location == UINT32_MAX)
+					continue;
+
+				ReflectedInput input;
+				input.location = variable.location;
+				input.format = inputFormat(ids, typeId);
+				reflection.inputs.push_back(input);
+			}
+			else if (variable.set != UINT32_MAX && variable.binding != UINT32_MAX)
+			{
+				ReflectedBinding binding{};
+				binding.set = variable.set;
+				binding.binding = variable.binding;
+				binding.stages = reflection.stages;
+
+				if (!descriptorType(ids, storageClass, typeId, binding.type, binding.count))
+				{
+					error = "unsupported resource at set " + std::to_string(binding.set) + " binding " + std::to_string(binding.binding);
+					return false;
+				}
+
+				reflection.bindings.push_back(binding);
+			}
+		}
+
+		std::sort(reflection.bindings.begin(), reflection.bindings.end(), [](const ReflectedBinding& a, const ReflectedBinding& b)
+		{
+			return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+		});
+
+		std::sort(reflection.inputs.begin(), reflection.inputs.end(), [](const ReflectedInput& a, const ReflectedInput& b)
+		{
+			return a.location < b.location;
+		});
+
+		return true;
+	}
+
+	bool vk_reflect::merge(ShaderReflection& target, const ShaderReflection& source, std::string& error)
+	{
+		target.stages |= source.stages;
+
+		for (const ReflectedBinding& binding : source.bindings)
+		{
+			auto it = std::find_if(target.bindings.begin(), target.bindings.end(), [&](const ReflectedBinding& other)
+			{
+				return other.set == binding.set && other.binding == binding.binding;
+			});
+
+			if (it == target.bindings.end())
+			{
+				target.bindings.push_back(binding);
+			}
+			else if (it->type != binding.type || it->count != binding.count)
+			{
+				error = "stages disagree on set " + std::to_string(binding.set) + " binding " + std::to_string(binding.binding);
+				return false;
+			}
+			else
+			{
+				it->stages |= binding.stages;
+			}
+		}
+
+		// one range covering every stage's block, GLSL shares a single push constant block
+		for (const VkPushConstantRange& range : source.pushConstants)
+		{
+			if (target.pushConstants.empty())
+			{
+				target.pushConstants.push_back(range);
+			}
+			else
+			{
+				target.pushConstants[0].stageFlags |= range.stageFlags;
+				target.pushConstants[0].size = std::max(target.pushConstants[0].size, range.size);
+			}
+		}
+
+		if (!source.inputs.empty())
+			target.inputs = source.inputs;
+
+		std::sort(target.bindings.begin(), target.bindings.end(), [](const ReflectedBinding& a, const ReflectedBinding& b)
+		{
+			return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+		});
+
+		return true;
+	}
+
+}
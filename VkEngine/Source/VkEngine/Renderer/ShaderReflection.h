@@ -0,0 +1,40 @@
+#pragma once
+#include "vk_engine/renderer/vk_type.h"
+#include <string>
+
+namespace vk_engine
+{
+
+	struct ReflectedBinding
+	{
+		uint32_t set;
+		uint32_t binding;
+		VkDescriptorType type;
+		uint32_t count; // 0 for runtime sized arrays
+		VkShaderStageFlags stages;
+	};
+
+	struct ReflectedInput
+	{
+		uint32_t location;
+		VkFormat format;
+	};
+
+	struct ShaderReflection
+	{
+		VkShaderStageFlags stages{ 0 };
+		std::vector<ReflectedBinding> bindings; // sorted by set then binding
+		std::vector<VkPushConstantRange> pushConstants;
+		std::vector<ReflectedInput> inputs; // vertex stage only, built-ins excluded
+	};
+
+	// minimal SPIR-V reflection, enough to derive descriptor set, push constant and vertex input layouts
+	namespace vk_reflect
+	{
+		bool reflect(const uint32_t* code, size_t wordCount, ShaderReflection& reflection, std::string& error);
+
+		// union of several stages, bindings used by more than one stage get their stage flags combined
+		bool merge(ShaderReflection& target, const ShaderReflection& source, std::string& error);
+	}
+
+}
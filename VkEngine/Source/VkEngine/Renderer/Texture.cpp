@@ -1,8 +1,7 @@
 #include "vk_engine/renderer/vk_texture.h"
 #include "vk_engine/renderer/vk_info.h"
 #include "vk_engine/assets/assets.h"
-
-#include <iostream>
+#include "vk_engine/core/logger.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -10,25 +9,45 @@
 namespace vk_engine
 {
 
-	bool vk_util::load_image_from_file(vk_renderer* renderer, const char* file, AllocatedImage& outImage)
+	bool vk_util::load_image_from_file(vk_renderer* renderer, const char* file, AllocatedImage& outImage, VkFormat& outFormat)
 	{
 		assets::assetFile asset{};
-		assets::loadAssetFile(file, asset);
+		if (!assets::loadAssetFile(file, asset))
+		{
+			return false;
+		}
+
+#ifndef NDEBUG
+		if (assets::isAssetStale(file, asset))
+		{
+			VK_LOG_WARN(std::string(file) + " is out of date with its source, rerun VkAsset");
+		}
+#endif
 
 		assets::textureInfo textInfo = assets::readTextureInfo(&asset);
 
-		VkFormat image_format = (VkFormat) textInfo.format;
+		// BC payloads without device support are transcoded to RGBA8
+		bool transcode = textInfo.compression == assets::compressionMode::BCLZ4 && !renderer->_supportsBC;
+
+		VkFormat image_format = transcode ? VK_FORMAT_R8G8B8A8_SRGB : (VkFormat) textInfo.format;
+		size_t imageSize = transcode ? (size_t) textInfo.width * textInfo.height * 4 : textInfo.textureSize;
 
-		AllocatedBuffer stageingBuffer = renderer->create_buffer(textInfo.textureSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+		AllocatedBuffer stageingBuffer = renderer->create_buffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
 
 		// copy texture data
 		void* data;
 		vmaMapMemory(renderer->_allocator, stageingBuffer._allocation, &data);
 
-		std::cout << "compressed size: " << asset.binaryBlob.size() << std::endl;
-		std::cout << "dest size: " << textInfo.textureSize << std::endl;
-
-		assets::unpackTexture(&textInfo, asset.binaryBlob.data(), asset.binaryBlob.size(), (char*) data);
+		if (transcode)
+		{
+			std::vector<char> texels(textInfo.textureSize);
+			assets::unpackTexture(&textInfo, asset.binaryBlob.data(), asset.binaryBlob.size(), texels.data());
+			assets::transcodeTexture(&textInfo, texels.data(), (char*) data);
+		}
+		else
+		{
+			assets::unpackTexture(&textInfo, asset.binaryBlob.data(), asset.binaryBlob.size(), (char*) data);
+		}
 
 		vmaUnmapMemory(renderer->_allocator, stageingBuffer._allocation);
 
@@ -87,14 +106,10 @@ namespace vk_engine
 			vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier_toReadable);
 		});
 
-		renderer->_deletionQueue.push_function([=]()
-		{
-			vmaDestroyImage(renderer->_allocator, newImage._image, newImage._allocation);
-		});
-
 		vmaDestroyBuffer(renderer->_allocator, stageingBuffer._buffer, stageingBuffer._allocation);
 
 		outImage = newImage;
+		outFormat = image_format;
 
 		return true;
 	}
@@ -8,7 +8,8 @@ namespace vk_engine
 
 	namespace vk_util
 	{
-		bool load_image_from_file(vk_engine::vk_renderer* renderer, const char* file, AllocatedImage& outImage);
+		// supercompressed textures are transcoded on the calling thread, outFormat receives the format the image was created with, the image belongs to the caller
+		bool load_image_from_file(vk_engine::vk_renderer* renderer, const char* file, AllocatedImage& outImage, VkFormat& outFormat);
 	}
 
 }
@@ -0,0 +1,36 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define VK_ENGINE_SSE
+#endif
+
+namespace vk_engine
+{
+
+	/* write the first three rows of an affine matrix, the shader rebuilds the position with three dot products
+	* rows must be 16 byte aligned, glm stores the matrix column major so it is transposed on the way
+	*/
+	inline void pack_affine(const glm::mat4& matrix, glm::vec4* rows)
+	{
+#ifdef VK_ENGINE_SSE
+		__m128 c0 = _mm_loadu_ps(&matrix[0][0]);
+		__m128 c1 = _mm_loadu_ps(&matrix[1][0]);
+		__m128 c2 = _mm_loadu_ps(&matrix[2][0]);
+		__m128 c3 = _mm_loadu_ps(&matrix[3][0]);
+
+		_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+		_mm_store_ps(&rows[0][0], c0);
+		_mm_store_ps(&rows[1][0], c1);
+		_mm_store_ps(&rows[2][0], c2);
+#else
+		for (int r = 0; r < 3; r++)
+		{
+			rows[r] = glm::vec4(matrix[0][r], matrix[1][r], matrix[2][r], matrix[3][r]);
+		}
+#endif
+	}
+
+}
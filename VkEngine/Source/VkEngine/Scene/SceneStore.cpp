@@ -0,0 +1,156 @@
+#include "VkEngine/Scene/SceneStore.h"
+#include "VkEngine/Renderer/Mesh.h"
+#include <stdexcept>
+
+namespace vk_engine
+{
+
+	ObjectHandle SceneStore::create(Mesh* mesh, uint32_t submesh, Material* material, const glm::mat4& transform)
+	{
+		if (submesh >= mesh->_submeshes.size())
+		{
+			throw std::runtime_error("failed to create object, the mesh has no submesh " + std::to_string(submesh) + "!");
+		}
+
+		uint32_t slot;
+		if (!_freeSlots.empty())
+		{
+			slot = _freeSlots.back();
+			_freeSlots.pop_back();
+		}
+		else
+		{
+			slot = (uint32_t) _slots.size();
+			_slots.emplace_back();
+		}
+
+		uint32_t index = size();
+		_slots[slot].index = index;
+
+		_transforms.push_back(transform);
+		_boundsMin.push_back(mesh->_submeshes[submesh].boundsMin);
+		_boundsMax.push_back(mesh->_submeshes[submesh].boundsMax);
+		_meshes.push_back(mesh);
+		_submeshes.push_back(submesh);
+		_materials.push_back(material);
+		_flags.push_back(0);
+		_queued.push_back(0);
+		_owners.push_back(slot);
+
+		mark_dirty(index);
+
+		return { slot, _slots[slot].generation };
+	}
+
+	void SceneStore::destroy(ObjectHandle handle)
+	{
+		if (!valid(handle))
+			return;
+
+		uint32_t index = _slots[handle.slot].index;
+		uint32_t last = size() - 1;
+
+		// the last object takes over the hole, its data moved so it has to be uploaded again
+		if (index != last)
+		{
+			_transforms[index] = _transforms[last];
+			_boundsMin[index] = _boundsMin[last];
+			_boundsMax[index] = _boundsMax[last];
+			_meshes[index] = _meshes[last];
+			_submeshes[index] = _submeshes[last];
+			_materials[index] = _materials[last];
+			_flags[index] = _flags[last];
+			_queued[index] = _queued[last];
+			_owners[index] = _owners[last];
+
+			_slots[_owners[index]].index = index;
+		}
+
+		_transforms.pop_back();
+		_boundsMin.pop_back();
+		_boundsMax.pop_back();
+		_meshes.pop_back();
+		_submeshes.pop_back();
+		_materials.pop_back();
+		_flags.pop_back();
+		_queued.pop_back();
+		_owners.pop_back();
+
+		// drop the entries of the removed object and of the old last index, the moved object is queued again below
+		for (size_t i = 0; i < _dirty.size(); )
+		{
+			if (_dirty[i] == index || _dirty[i] >= size())
+			{
+				_dirty[i] = _dirty.back();
+				_dirty.pop_back();
+			}
+			else
+			{
+				i++;
+			}
+		}
+
+		if (index != last)
+		{
+			_queued[index] = 0;
+			mark_dirty(index);
+		}
+
+		_slots[handle.slot].generation++;
+		_freeSlots.push_back(handle.slot);
+	}
+
+	bool SceneStore::valid(ObjectHandle handle) const
+	{
+		return handle.slot < _slots.size() && _slots[handle.slot].generation == handle.generation;
+	}
+
+	void SceneStore::set_transform(ObjectHandle handle, const glm::mat4& transform)
+	{
+		if (!valid(handle))
+			return;
+
+		uint32_t index = _slots[handle.slot].index;
+		_transforms[index] = transform;
+		mark_dirty(index);
+	}
+
+	void SceneStore::set_hidden(ObjectHandle handle, bool hidden)
+	{
+		if (!valid(handle))
+			return;
+
+		uint32_t index = _slots[handle.slot].index;
+		if (hidden)
+			_flags[index] |= OBJECT_HIDDEN;
+		else
+			_flags[index] &= ~OBJECT_HIDDEN;
+	}
+
+	void SceneStore::mark_dirty(uint32_t index)
+	{
+		if (!_queued[index])
+		{
+			_queued[index] = 1;
+			_dirty.push_back(index);
+		}
+	}
+
+	void SceneStore::mark_all_dirty()
+	{
+		for (uint32_t i = 0; i < size(); i++)
+		{
+			mark_dirty(i);
+		}
+	}
+
+	void SceneStore::clear_dirty()
+	{
+		for (uint32_t index : _dirty)
+		{
+			_queued[index] = 0;
+		}
+		_dirty.clear();
+	}
+
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace vk_engine
+{
+
+	struct Mesh;
+	struct Material;
+
+	/* names an object independently of where its data currently sits in the columns,
+	* the generation is bumped whenever a slot is reused so handles to removed objects stop resolving
+	*/
+	struct ObjectHandle
+	{
+		uint32_t slot{ UINT32_MAX };
+		uint32_t generation{ 0 };
+	};
+
+	// read by the culling worker while a frame is recorded, so only changed between frames
+	enum ObjectFlags : uint8_t
+	{
+		OBJECT_HIDDEN = 1 << 0, // kept but never drawn
+	};
+
+	/* every drawable object as parallel columns, index i of each column belongs to the same object
+	* the columns stay dense, destroy moves the last object into the hole so indices of other objects can change
+	* not thread safe, the renderer only changes it between frames
+	*/
+	class SceneStore
+	{
+	public:
+		ObjectHandle create(Mesh* mesh, uint32_t submesh, Material* material, const glm::mat4& transform);
+		void destroy(ObjectHandle handle);
+
+		bool valid(ObjectHandle handle) const;
+		// current column index, UINT32_MAX once the object was destroyed
+		uint32_t index(ObjectHandle handle) const { return valid(handle) ? _slots[handle.slot].index : UINT32_MAX; }
+
+		// both ignore handles to destroyed objects, their slot may belong to another object by now
+		void set_transform(ObjectHandle handle, const glm::mat4& transform);
+		void set_hidden(ObjectHandle handle, bool hidden);
+
+		uint32_t size() const { return (uint32_t) _transforms.size(); }
+
+		// columns
+		const std::vector<glm::mat4>& transforms() const { return _transforms; }
+		const std::vector<glm::vec3>& bounds_min() const { return _boundsMin; } // model space, copied from the submesh
+		const std::vector<glm::vec3>& bounds_max() const { return _boundsMax; }
+		const std::vector<Mesh*>& meshes() const { return _meshes; }
+		const std::vector<uint32_t>& submeshes() const { return _submeshes; }
+		const std::vector<Material*>& materials() const { return _materials; }
+		const std::vector<uint8_t>& flags() const { return _flags; }
+
+		// column indices queued for upload by create and set_transform, in no particular order
+		const std::vector<uint32_t>& dirty() const { return _dirty; }
+		void clear_dirty();
+		void mark_dirty(uint32_t index);
+		void mark_all_dirty();
+
+	private:
+		std::vector<glm::mat4> _transforms;
+		std::vector<glm::vec3> _boundsMin;
+		std::vector<glm::vec3> _boundsMax;
+		std::vector<Mesh*> _meshes;
+		std::vector<uint32_t> _submeshes;
+		std::vector<Material*> _materials;
+		std::vector<uint8_t> _flags;
+		std::vector<uint8_t> _queued; // whether the index is in _dirty, apart from _flags since the workers never read it
+		std::vector<uint32_t> _owners; // slot of each column index, to fix the slot of the object moved by destroy
+
+		struct Slot
+		{
+			uint32_t index{ 0 };
+			uint32_t generation{ 0 };
+		};
+
+		std::vector<Slot> _slots;
+		std::vector<uint32_t> _freeSlots;
+
+		std::vector<uint32_t> _dirty;
+	};
+
+}
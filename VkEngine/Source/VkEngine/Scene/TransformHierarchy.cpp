@@ -0,0 +1,276 @@
+#include "VkEngine/Scene/TransformHierarchy.h"
+#include "VkEngine/Core/Parallel.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace vk_engine
+{
+
+	// nodes evaluated by one parallel_for item, smaller levels are evaluated on the calling thread
+	constexpr size_t NODES_PER_TASK = 4096;
+
+	NodeHandle TransformHierarchy::create(const glm::mat4& local, NodeHandle parent)
+	{
+		uint32_t levelIndex = 0;
+		uint32_t parentIndex = 0;
+
+		if (parent.slot != UINT32_MAX)
+		{
+			if (!valid(parent))
+			{
+				throw std::runtime_error("failed to create node, the parent was destroyed!");
+			}
+
+			levelIndex = _slots[parent.slot].level + 1;
+			parentIndex = _slots[parent.slot].index;
+		}
+
+		if (levelIndex == _levels.size())
+		{
+			_levels.emplace_back();
+		}
+
+		uint32_t slot;
+		if (!_freeSlots.empty())
+		{
+			slot = _freeSlots.back();
+			_freeSlots.pop_back();
+		}
+		else
+		{
+			slot = (uint32_t) _slots.size();
+			_slots.emplace_back();
+		}
+
+		Level& level = _levels[levelIndex];
+
+		Slot& node = _slots[slot];
+		node.level = levelIndex;
+		node.index = (uint32_t) level.local.size();
+		node.parent = parent.slot;
+		node.firstChild = UINT32_MAX;
+		node.prevSibling = UINT32_MAX;
+		node.nextSibling = UINT32_MAX;
+
+		if (parent.slot != UINT32_MAX)
+		{
+			node.nextSibling = _slots[parent.slot].firstChild;
+			if (node.nextSibling != UINT32_MAX)
+			{
+				_slots[node.nextSibling].prevSibling = slot;
+			}
+			_slots[parent.slot].firstChild = slot;
+		}
+
+		level.local.push_back(local);
+		level.world.push_back(glm::mat4{ 1.0f });
+		level.parent.push_back(parentIndex);
+		level.dirty.push_back(1);
+		level.changed.push_back(0);
+		level.owner.push_back(slot);
+		level.anyDirty = true;
+
+		_size++;
+
+		return { slot, _slots[slot].generation };
+	}
+
+	std::vector<NodeHandle> TransformHierarchy::destroy(NodeHandle handle)
+	{
+		std::vector<NodeHandle> destroyed;
+		if (!valid(handle))
+			return destroyed;
+
+		// the subtree breadth first through the child lists, removed back to front so children go before their parent
+		std::vector<uint32_t> subtree{ handle.slot };
+		for (size_t i = 0; i < subtree.size(); i++)
+		{
+			for (uint32_t child = _slots[subtree[i]].firstChild; child != UINT32_MAX; child = _slots[child].nextSibling)
+			{
+				subtree.push_back(child);
+			}
+		}
+
+		destroyed.reserve(subtree.size());
+		for (size_t i = subtree.size(); i-- > 0; )
+		{
+			uint32_t slot = subtree[i];
+			destroyed.push_back({ slot, _slots[slot].generation });
+
+			remove(slot);
+		}
+
+		while (!_levels.empty() && _levels.back().local.empty())
+		{
+			_levels.pop_back();
+		}
+
+		return destroyed;
+	}
+
+	void TransformHierarchy::remove(uint32_t slot)
+	{
+		unlink(slot);
+
+		uint32_t levelIndex = _slots[slot].level;
+		uint32_t index = _slots[slot].index;
+
+		Level& level = _levels[levelIndex];
+		uint32_t last = (uint32_t) level.local.size() - 1;
+
+		if (index != last)
+		{
+			level.local[index] = level.local[last];
+			level.world[index] = level.world[last];
+			level.parent[index] = level.parent[last];
+			level.dirty[index] = level.dirty[last];
+			level.changed[index] = level.changed[last];
+			level.owner[index] = level.owner[last];
+
+			uint32_t moved = level.owner[index];
+			_slots[moved].index = index;
+
+			// children of the moved node still point at its old index
+			for (uint32_t child = _slots[moved].firstChild; child != UINT32_MAX; child = _slots[child].nextSibling)
+			{
+				_levels[levelIndex + 1].parent[_slots[child].index] = index;
+			}
+		}
+
+		level.local.pop_back();
+		level.world.pop_back();
+		level.parent.pop_back();
+		level.dirty.pop_back();
+		level.changed.pop_back();
+		level.owner.pop_back();
+
+		_slots[slot].generation++;
+		_freeSlots.push_back(slot);
+		_size--;
+	}
+
+	void TransformHierarchy::unlink(uint32_t slot)
+	{
+		Slot& node = _slots[slot];
+
+		if (node.prevSibling != UINT32_MAX)
+		{
+			_slots[node.prevSibling].nextSibling = node.nextSibling;
+		}
+		else if (node.parent != UINT32_MAX)
+		{
+			_slots[node.parent].firstChild = node.nextSibling;
+		}
+
+		if (node.nextSibling != UINT32_MAX)
+		{
+			_slots[node.nextSibling].prevSibling = node.prevSibling;
+		}
+
+		node.parent = UINT32_MAX;
+		node.nextSibling = UINT32_MAX;
+		node.prevSibling = UINT32_MAX;
+	}
+
+	bool TransformHierarchy::valid(NodeHandle handle) const
+	{
+		return handle.slot < _slots.size() && _slots[handle.slot].generation == handle.generation;
+	}
+
+	void TransformHierarchy::set_local(NodeHandle handle, const glm::mat4& local)
+	{
+		if (!valid(handle))
+			return;
+
+		Level& level = _levels[_slots[handle.slot].level];
+		uint32_t index = _slots[handle.slot].index;
+
+		level.local[index] = local;
+		level.dirty[index] = 1;
+		level.anyDirty = true;
+	}
+
+	const glm::mat4& TransformHierarchy::local(NodeHandle handle) const
+	{
+		if (!valid(handle))
+		{
+			throw std::runtime_error("failed to read node, it was destroyed!");
+		}
+
+		return _levels[_slots[handle.slot].level].local[_slots[handle.slot].index];
+	}
+
+	const glm::mat4& TransformHierarchy::world(NodeHandle handle) const
+	{
+		if (!valid(handle))
+		{
+			throw std::runtime_error("failed to read node, it was destroyed!");
+		}
+
+		return _levels[_slots[handle.slot].level].world[_slots[handle.slot].index];
+	}
+
+	void TransformHierarchy::update(std::vector<NodeHandle>& changed)
+	{
+		// whether the level before recomputed anything, otherwise its changed flags are stale and aren't read
+		bool parentChanged = false;
+
+		for (uint32_t l = 0; l < _levels.size(); l++)
+		{
+			Level& level = _levels[l];
+
+			if (!level.anyDirty && !parentChanged)
+				continue;
+
+			const Level* parent = l > 0 ? &_levels[l - 1] : nullptr;
+			const bool readParent = parentChanged;
+
+			auto evaluate = [&](size_t begin, size_t end)
+			{
+				for (size_t i = begin; i < end; i++)
+				{
+					bool moved = readParent && parent->changed[level.parent[i]];
+
+					if (level.dirty[i] || moved)
+					{
+						level.world[i] = parent ? parent->world[level.parent[i]] * level.local[i] : level.local[i];
+						level.dirty[i] = 0;
+						level.changed[i] = 1;
+					}
+					else
+					{
+						level.changed[i] = 0;
+					}
+				}
+			};
+
+			size_t count = level.local.size();
+			size_t tasks = (count + NODES_PER_TASK - 1) / NODES_PER_TASK;
+
+			if (tasks <= 1)
+			{
+				evaluate(0, count);
+			}
+			else
+			{
+				parallel_for(tasks, [&](size_t task)
+				{
+					evaluate(task * NODES_PER_TASK, std::min(count, (task + 1) * NODES_PER_TASK));
+				});
+			}
+
+			level.anyDirty = false;
+			parentChanged = false;
+
+			for (uint32_t i = 0; i < count; i++)
+			{
+				if (level.changed[i])
+				{
+					changed.push_back({ level.owner[i], _slots[level.owner[i]].generation });
+					parentChanged = true;
+				}
+			}
+		}
+	}
+
+}
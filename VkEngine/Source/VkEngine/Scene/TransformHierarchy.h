@@ -0,0 +1,78 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace vk_engine
+{
+
+	// a node of TransformHierarchy, generations work like ObjectHandle
+	struct NodeHandle
+	{
+		uint32_t slot{ UINT32_MAX };
+		uint32_t generation{ 0 };
+	};
+
+	/* parent / child transforms stored level by level, every node of a level has its parent in the level before
+	* update walks the levels in order and each level is split over parallel_for,
+	* a level is skipped entirely when nothing in it or above it changed since the last update
+	* not thread safe outside of update, the renderer only changes it between frames
+	*/
+	class TransformHierarchy
+	{
+	public:
+		// a default NodeHandle as parent makes a root
+		NodeHandle create(const glm::mat4& local, NodeHandle parent = {});
+		// removes the node with its whole subtree, returns every node removed
+		std::vector<NodeHandle> destroy(NodeHandle handle);
+
+		bool valid(NodeHandle handle) const;
+
+		// set_local ignores a destroyed node, local and world throw
+		void set_local(NodeHandle handle, const glm::mat4& local);
+		const glm::mat4& local(NodeHandle handle) const;
+		// as of the last update
+		const glm::mat4& world(NodeHandle handle) const;
+
+		// recompute the world matrix of every dirty node and its descendants, changed receives those nodes
+		void update(std::vector<NodeHandle>& changed);
+
+		uint32_t size() const { return _size; }
+		uint32_t depth() const { return (uint32_t) _levels.size(); }
+
+	private:
+		struct Level
+		{
+			std::vector<glm::mat4> local;
+			std::vector<glm::mat4> world;
+			std::vector<uint32_t> parent; // index into the level before, unused for roots
+			std::vector<uint8_t> dirty; // local changed since the last update
+			std::vector<uint8_t> changed; // world recomputed by the current update
+			std::vector<uint32_t> owner; // slot of each index
+			bool anyDirty{ false };
+		};
+
+		/* slots don't move, so the children of a node are linked through them,
+		* removing a node then only has to visit its own children instead of scanning the next level
+		*/
+		struct Slot
+		{
+			uint32_t level{ 0 };
+			uint32_t index{ 0 };
+			uint32_t generation{ 0 };
+			uint32_t parent{ UINT32_MAX };
+			uint32_t firstChild{ UINT32_MAX };
+			uint32_t nextSibling{ UINT32_MAX };
+			uint32_t prevSibling{ UINT32_MAX };
+		};
+
+		std::vector<Level> _levels;
+		std::vector<Slot> _slots;
+		std::vector<uint32_t> _freeSlots;
+		uint32_t _size{ 0 };
+
+		void remove(uint32_t slot); // a node without children
+		void unlink(uint32_t slot);
+	};
+
+}